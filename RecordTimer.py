@@ -385,6 +385,9 @@ class RecordTimerEntry(timer.TimerEntry, object):
 			# ok, the recording has been stopped. we need to properly note 
 			# that in our state, with also keeping the possibility to re-try.
 			# TODO: this has to be done.
+		elif event == iRecordableService.evRecordParserOverflow:
+			# the recording goes on, only its .ap/.sc files miss some entries
+			print "[RecordTimer] recording index incomplete, the system is too busy"
 		elif event == iRecordableService.evStart:
 			if self.pvrConvert:
 				return
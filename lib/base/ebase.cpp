@@ -3,19 +3,31 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+#endif
 
 #include <lib/base/eerror.h>
 #include <lib/base/elock.h>
+#include <lib/base/loopprofile.h>
 #include <lib/gdi/grc.h>
 
 DEFINE_REF(eSocketNotifier);
 
-eSocketNotifier::eSocketNotifier(eMainloop *context, int fd, int requested, bool startnow): context(*context), fd(fd), state(0), requested(requested)
+eSocketNotifier::eSocketNotifier(eMainloop *context, int fd, int requested, bool startnow): context(*context), fd(fd), state(0), requested(requested), m_creator(0)
 {
 	if (startnow)
 		start();
 }
 
+eSocketNotifier* eSocketNotifier::create(eMainloop *context, int fd, int req, bool startnow)
+{
+	eSocketNotifier *sn = new eSocketNotifier(context, fd, req, startnow);
+	sn->m_creator = __builtin_return_address(0);
+	return sn;
+}
+
 eSocketNotifier::~eSocketNotifier()
 {
 	stop();
@@ -42,6 +54,15 @@ void eSocketNotifier::stop()
 	}
 }
 
+void eSocketNotifier::setRequested(int req)
+{
+	requested=req;
+#ifdef HAVE_EPOLL
+	if (state)
+		context.updateSocketNotifier(this);
+#endif
+}
+
 DEFINE_REF(eTimer);
 
 void eTimer::start(long msek, bool singleShot)
@@ -105,6 +126,13 @@ void eTimer::changeInterval(long msek)
 	context.addTimer(this);				// add Timer to context TimerList
 }
 
+eTimer *eTimer::create(eMainloop *context)
+{
+	eTimer *timer = new eTimer(context);
+	timer->m_creator = __builtin_return_address(0);
+	return timer;
+}
+
 void eTimer::activate()   // Internal Funktion... called from eApplication
 {
 	context.removeTimer(this);
@@ -133,8 +161,12 @@ eMainloop::~eMainloop()
 	existing_loops.remove(this);
 	for (std::map<int, eSocketNotifier*>::iterator it(notifiers.begin());it != notifiers.end();++it)
 		it->second->stop();
-	while(m_timer_list.begin() != m_timer_list.end())
-		m_timer_list.begin()->stop();
+	while (!m_timers.empty())
+		m_timers.front()->stop();
+#ifdef HAVE_EPOLL
+	if (m_epoll_fd >= 0)
+		::close(m_epoll_fd);
+#endif
 }
 
 void eMainloop::addSocketNotifier(eSocketNotifier *sn)
@@ -153,6 +185,22 @@ void eMainloop::addSocketNotifier(eSocketNotifier *sn)
 	}
 	ASSERT(notifiers.find(fd) == notifiers.end());
 	notifiers[fd]=sn;
+#ifdef HAVE_EPOLL
+	epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = sn->getRequested(); // the POLL* and EPOLL* flags are the same
+	ev.data.fd = fd;
+	if (epoll_ctl(epollFd(), EPOLL_CTL_ADD, fd, &ev) < 0)
+	{
+		if (errno == EEXIST) // a closed fd with a dup still registered
+			epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+		else if (errno == EPERM) // like poll, a file is always ready
+			m_unpollable.insert(fd);
+		else
+			eDebug("[eMainloop] epoll_ctl add fd %d failed (%m)", fd);
+	}
+	m_started.push_back(sn);
+#endif
 }
 
 void eMainloop::removeSocketNotifier(eSocketNotifier *sn)
@@ -162,6 +210,14 @@ void eMainloop::removeSocketNotifier(eSocketNotifier *sn)
 	if (i != notifiers.end())
 	{
 		notifiers.erase(i);
+#ifdef HAVE_EPOLL
+		// fails when the fd is already closed, then it is removed anyway
+		if (!m_unpollable.erase(fd))
+			epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, 0);
+		std::vector<eSocketNotifier*>::iterator s = std::find(m_started.begin(), m_started.end(), sn);
+		if (s != m_started.end())
+			m_started.erase(s);
+#endif
 		return;
 	}
 	for (i = notifiers.begin(); i != notifiers.end(); ++i)
@@ -180,16 +236,26 @@ int eMainloop::processOneEvent(unsigned int twisted_timeout, PyObject **res, ePy
 	if (additional && !res)
 		eFatal("additional, but no res");
 
+	if (eMainloopProfile::enabled && this == eApp)
+		eMainloopProfile::checkDump();
+
 	long poll_timeout = -1; /* infinite in case of empty timer list */
 
-	if (!m_timer_list.empty())
+	if (!m_timers.empty())
 	{
 		/* process all timers which are ready. first remove them out of the list. */
-		while (!m_timer_list.empty() && (poll_timeout = timeout_usec( m_timer_list.begin()->getNextActivation() ) ) <= 0 )
+		while (!m_timers.empty() && (poll_timeout = timeout_usec( m_timers.front()->getNextActivation() ) ) <= 0 )
 		{
-			eTimer *tmr = m_timer_list.begin();
+			eTimer *tmr = m_timers.front();
 			tmr->AddRef();
-			tmr->activate();
+			if (eMainloopProfile::enabled)
+			{
+				eMainloopProfile::begin();
+				tmr->activate();
+				eMainloopProfile::end(eMainloopProfile::Timer, tmr->m_creator, tmr->timeout);
+			}
+			else
+				tmr->activate();
 			tmr->Release();
 		}
 		if (poll_timeout < 0)
@@ -204,6 +270,186 @@ int eMainloop::processOneEvent(unsigned int twisted_timeout, PyObject **res, ePy
 		return_reason = 1;
 	}
 
+#ifdef HAVE_EPOLL
+	int ret = waitEvents(poll_timeout, res, additional);
+#else
+	int ret = pollEvents(poll_timeout, res, additional);
+#endif
+
+			/* ret > 0 means that there are some active poll entries. */
+	if (ret > 0)
+		return_reason = 0;
+	else if (ret < 0)
+	{
+			/* when we got a signal, we get EINTR. */
+		if (errno != EINTR)
+			eDebug("poll made error (%m)");
+		else
+			return_reason = 2; /* don't assume the timeout has passed when we got a signal */
+	}
+
+	return return_reason;
+}
+
+void eMainloop::activateNotifier(int fd, int revents)
+{
+	std::map<int,eSocketNotifier*>::iterator it = notifiers.find(fd);
+	if (it != notifiers.end()
+		&& it->second->state == 1) // added and in poll
+	{
+		m_inActivate = it->second;
+		int req = m_inActivate->getRequested();
+		if (revents & req) {
+			m_inActivate->AddRef();
+			if (eMainloopProfile::enabled)
+			{
+				eMainloopProfile::begin();
+				m_inActivate->activate(revents & req);
+				eMainloopProfile::end(eMainloopProfile::Notifier, m_inActivate->m_creator, m_inActivate->activated, fd);
+			}
+			else
+				m_inActivate->activate(revents & req);
+			m_inActivate->Release();
+		}
+		revents &= ~req;
+		m_inActivate = 0;
+	}
+	if (revents & (POLLERR|POLLHUP|POLLNVAL))
+		eDebug("poll: unhandled POLLERR/HUP/NVAL for fd %d(%d)", fd, revents);
+}
+
+#if PY_VERSION_HEX < 0x02050000 && !defined(PY_SSIZE_T_MIN)
+typedef int Py_ssize_t;
+# define PY_SSIZE_T_MAX INT_MAX
+# define PY_SSIZE_T_MIN INT_MIN
+#endif
+
+static void addPythonFds(pollfd *pfd, ePyObject additional)
+{
+	PyObject *key, *val;
+	Py_ssize_t pos=0;
+	while (PyDict_Next(additional, &pos, &key, &val)) {
+		pfd->fd = PyObject_AsFileDescriptor(key);
+		pfd++->events = PyInt_AsLong(val);
+	}
+}
+
+static void getPythonResults(PyObject **res, pollfd *pfd, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		if (pfd[i].revents)
+		{
+			if (!*res)
+				*res = PyList_New(0);
+			ePyObject it = PyTuple_New(2);
+			PyTuple_SET_ITEM(it, 0, PyInt_FromLong(pfd[i].fd));
+			PyTuple_SET_ITEM(it, 1, PyInt_FromLong(pfd[i].revents));
+			PyList_Append(*res, it);
+			Py_DECREF(it);
+		}
+	}
+}
+
+#ifdef HAVE_EPOLL
+int eMainloop::epollFd()
+{
+	if (m_epoll_fd < 0)
+	{
+		m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (m_epoll_fd < 0)
+			eFatal("epoll_create1 failed (%m)");
+	}
+	return m_epoll_fd;
+}
+
+void eMainloop::updateSocketNotifier(eSocketNotifier *sn)
+{
+	int fd = sn->getFD();
+	if (m_unpollable.find(fd) != m_unpollable.end())
+		return;
+	epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = sn->getRequested(); // the POLL* and EPOLL* flags are the same
+	ev.data.fd = fd;
+	if (epoll_ctl(epollFd(), EPOLL_CTL_MOD, fd, &ev) < 0)
+		eDebug("[eMainloop] epoll_ctl mod fd %d failed (%m)", fd);
+}
+
+	/* the native fds are registered with epoll. the python fds are polled
+	   together with the epoll fd, which is readable when one of the native
+	   fds is ready. */
+int eMainloop::waitEvents(long poll_timeout, PyObject **res, ePyObject additional)
+{
+	enum { MAX_EVENTS = 64 };
+	epoll_event events[MAX_EVENTS];
+	int pycount = additional ? PyDict_Size(additional) : 0,
+		nevents = 0,
+		ret = 0;
+	pollfd pfd[pycount + 1];
+
+	for (std::vector<eSocketNotifier*>::iterator it(m_started.begin()); it != m_started.end(); ++it)
+		(*it)->state = 1; // running and in poll
+	m_started.clear();
+
+	if (!m_unpollable.empty())
+		poll_timeout = 0;
+
+	if (additional)
+	{
+		pfd[0].fd = epollFd();
+		pfd[0].events = POLLIN;
+		addPythonFds(pfd + 1, additional);
+	}
+
+	bool profile = eMainloopProfile::enabled;
+	timespec poll_start;
+	if (profile)
+		clock_gettime(CLOCK_MONOTONIC, &poll_start);
+
+	m_is_idle = 1;
+	++m_idle_count;
+
+	if (this == eApp)
+	{
+		Py_BEGIN_ALLOW_THREADS
+		if (additional)
+			ret = ::poll(pfd, pycount + 1, poll_timeout);
+		else
+			ret = nevents = epoll_wait(epollFd(), events, MAX_EVENTS, poll_timeout);
+		Py_END_ALLOW_THREADS
+	} else if (additional)
+		ret = ::poll(pfd, pycount + 1, poll_timeout);
+	else
+		ret = nevents = epoll_wait(epollFd(), events, MAX_EVENTS, poll_timeout);
+
+	m_is_idle = 0;
+
+	if (profile)
+		eMainloopProfile::poll(poll_start);
+
+	if (ret < 0)
+		return ret;
+	if (additional && (pfd[0].revents & POLLIN))
+		nevents = epoll_wait(epollFd(), events, MAX_EVENTS, 0);
+
+	for (int i = 0; i < nevents; ++i)
+		activateNotifier(events[i].data.fd, events[i].events);
+	if (!m_unpollable.empty())
+	{
+		// copied, the callbacks may stop the notifiers
+		std::vector<int> fds(m_unpollable.begin(), m_unpollable.end());
+		for (std::vector<int>::iterator it(fds.begin()); it != fds.end(); ++it)
+			activateNotifier(*it, POLLIN|POLLOUT);
+		ret += fds.size();
+	}
+	if (additional)
+		getPythonResults(res, pfd + 1, pycount);
+	return ret;
+}
+#else
+int eMainloop::pollEvents(long poll_timeout, PyObject **res, ePyObject additional)
+{
 	int nativecount=notifiers.size(),
 		fdcount=nativecount,
 		ret=0;
@@ -224,19 +470,12 @@ int eMainloop::processOneEvent(unsigned int twisted_timeout, PyObject **res, ePy
 	}
 
 	if (additional)
-	{
-#if PY_VERSION_HEX < 0x02050000 && !defined(PY_SSIZE_T_MIN)
-		typedef int Py_ssize_t;
-# define PY_SSIZE_T_MAX INT_MAX
-# define PY_SSIZE_T_MIN INT_MIN
-#endif
-		PyObject *key, *val;
-		Py_ssize_t pos=0;
-		while (PyDict_Next(additional, &pos, &key, &val)) {
-			pfd[i].fd = PyObject_AsFileDescriptor(key);
-			pfd[i++].events = PyInt_AsLong(val);
-		}
-	}
+		addPythonFds(pfd + i, additional);
+
+	bool profile = eMainloopProfile::enabled;
+	timespec poll_start;
+	if (profile)
+		clock_gettime(CLOCK_MONOTONIC, &poll_start);
 
 	m_is_idle = 1;
 	++m_idle_count;
@@ -251,67 +490,84 @@ int eMainloop::processOneEvent(unsigned int twisted_timeout, PyObject **res, ePy
 
 	m_is_idle = 0;
 
-			/* ret > 0 means that there are some active poll entries. */
+	if (profile)
+		eMainloopProfile::poll(poll_start);
+
 	if (ret > 0)
 	{
-		int i=0;
-		return_reason = 0;
-		for (; i < nativecount; ++i)
-		{
-			if (pfd[i].revents)
-			{
-				it = notifiers.find(pfd[i].fd);
-				if (it != notifiers.end()
-					&& it->second->state == 1) // added and in poll
-				{
-					m_inActivate = it->second;
-					int req = m_inActivate->getRequested();
-					if (pfd[i].revents & req) {
-						m_inActivate->AddRef();
-						m_inActivate->activate(pfd[i].revents & req);
-						m_inActivate->Release();
-					}
-					pfd[i].revents &= ~req;
-					m_inActivate = 0;
-				}
-				if (pfd[i].revents & (POLLERR|POLLHUP|POLLNVAL))
-					eDebug("poll: unhandled POLLERR/HUP/NVAL for fd %d(%d)", pfd[i].fd, pfd[i].revents);
-			}
-		}
-		for (; i < fdcount; ++i)
-		{
+		for (i = 0; i < nativecount; ++i)
 			if (pfd[i].revents)
-			{
-				if (!*res)
-					*res = PyList_New(0);
-				ePyObject it = PyTuple_New(2);
-				PyTuple_SET_ITEM(it, 0, PyInt_FromLong(pfd[i].fd));
-				PyTuple_SET_ITEM(it, 1, PyInt_FromLong(pfd[i].revents));
-				PyList_Append(*res, it);
-				Py_DECREF(it);
-			}
-		}
+				activateNotifier(pfd[i].fd, pfd[i].revents);
+		getPythonResults(res, pfd + nativecount, fdcount - nativecount);
 	}
-	else if (ret < 0)
+	return ret;
+}
+#endif
+
+bool eMainloop::timerBefore(const eTimer *a, const eTimer *b)
+{
+	if (a->nextActivation < b->nextActivation)
+		return true;
+	if (b->nextActivation < a->nextActivation)
+		return false;
+	return (int)(a->m_sequence - b->m_sequence) < 0; // started first
+}
+
+void eMainloop::timerUp(size_t pos)
+{
+	eTimer *e = m_timers[pos];
+	while (pos)
 	{
-			/* when we got a signal, we get EINTR. */
-		if (errno != EINTR)
-			eDebug("poll made error (%m)");
-		else
-			return_reason = 2; /* don't assume the timeout has passed when we got a signal */
+		size_t parent = (pos - 1) / 2;
+		if (!timerBefore(e, m_timers[parent]))
+			break;
+		m_timers[pos] = m_timers[parent];
+		m_timers[pos]->m_heap_index = pos;
+		pos = parent;
 	}
+	m_timers[pos] = e;
+	e->m_heap_index = pos;
+}
 
-	return return_reason;
+void eMainloop::timerDown(size_t pos)
+{
+	eTimer *e = m_timers[pos];
+	size_t size = m_timers.size();
+	while (2 * pos + 1 < size)
+	{
+		size_t child = 2 * pos + 1;
+		if (child + 1 < size && timerBefore(m_timers[child + 1], m_timers[child]))
+			++child;
+		if (!timerBefore(m_timers[child], e))
+			break;
+		m_timers[pos] = m_timers[child];
+		m_timers[pos]->m_heap_index = pos;
+		pos = child;
+	}
+	m_timers[pos] = e;
+	e->m_heap_index = pos;
 }
 
 void eMainloop::addTimer(eTimer* e)
 {
-	m_timer_list.insert_in_order(e);
+	e->m_sequence = m_timer_sequence++;
+	m_timers.push_back(e);
+	timerUp(m_timers.size() - 1);
 }
 
 void eMainloop::removeTimer(eTimer* e)
 {
-	m_timer_list.remove(e);
+	if (e->m_heap_index < 0)
+		return;
+	size_t pos = e->m_heap_index;
+	e->m_heap_index = -1;
+	eTimer *last = m_timers.back();
+	m_timers.pop_back();
+	if (last == e)
+		return;
+	m_timers[pos] = last;
+	timerUp(pos);
+	timerDown(last->m_heap_index);
 }
 
 int eMainloop::iterate(unsigned int twisted_timeout, PyObject **res, ePyObject dict)
@@ -4,6 +4,7 @@
 #ifndef SWIG
 #include <vector>
 #include <map>
+#include <set>
 #include <sys/poll.h>
 #include <sys/time.h>
 #include <asm/types.h>
@@ -153,6 +154,7 @@ private:
 	int fd;
 	int state;
 	int requested;		// requested events (POLLIN, ...)
+	void *m_creator; // the caller of create, names the callback in eMainloopProfile
 	void activate(int what) { /*emit*/ activated(what); }
 	eSocketNotifier(eMainloop *context, int fd, int req, bool startnow);
 public:
@@ -163,7 +165,7 @@ public:
 	 * \param req The events to watch to, normally either \c Read or \c Write. You can specify any events that \c poll supports.
 	 * \param startnow Specifies if the socketnotifier should start immediately.
 	 */
-	static eSocketNotifier* create(eMainloop *context, int fd, int req, bool startnow=true) { return new eSocketNotifier(context, fd, req, startnow); }
+	static eSocketNotifier* create(eMainloop *context, int fd, int req, bool startnow=true) __attribute__((noinline));
 	~eSocketNotifier();
 
 	PSignal1<void, int> activated;
@@ -174,7 +176,7 @@ public:
 
 	int getFD() { return fd; }
 	int getRequested() { return requested; }
-	void setRequested(int req) { requested=req; }
+	void setRequested(int req);
 
 	eSmartPtrList<iObject> m_clients;
 };
@@ -189,7 +191,9 @@ class eMainloop
 	friend class eTimer;
 	friend class eSocketNotifier;
 	std::map<int, eSocketNotifier*> notifiers;
-	ePtrList<eTimer> m_timer_list;
+	// binary heap of the active timers, the next one to fire first
+	std::vector<eTimer*> m_timers;
+	unsigned int m_timer_sequence;
 	bool app_quit_now;
 	int loop_level;
 	int processOneEvent(unsigned int user_timeout, PyObject **res=0, ePyObject additional=ePyObject());
@@ -203,13 +207,29 @@ class eMainloop
 
 	void addSocketNotifier(eSocketNotifier *sn);
 	void removeSocketNotifier(eSocketNotifier *sn);
+	void activateNotifier(int fd, int revents);
+	// the notifiers stay registered in the epoll set while they are running.
+	// m_started are the notifiers started since the last wait, m_unpollable
+	// the fds epoll doesn't support (regular files), they are always ready.
+	// declared also without HAVE_EPOLL, the layout of eMainloop must not
+	// depend on enigma2_config.h which is not installed for the plugins
+	int m_epoll_fd;
+	std::vector<eSocketNotifier*> m_started;
+	std::set<int> m_unpollable;
+	int epollFd();
+	void updateSocketNotifier(eSocketNotifier *sn);
+	int waitEvents(long poll_timeout, PyObject **res, ePyObject additional);
+	int pollEvents(long poll_timeout, PyObject **res, ePyObject additional);
 	void addTimer(eTimer* e);
 	void removeTimer(eTimer* e);
+	static bool timerBefore(const eTimer *a, const eTimer *b);
+	void timerUp(size_t pos);
+	void timerDown(size_t pos);
 	static ePtrList<eMainloop> existing_loops;
 	static bool isValid(eMainloop *);
 public:
 	eMainloop()
-		:app_quit_now(0),loop_level(0),retval(0), m_is_idle(0), m_idle_count(0), m_inActivate(0), m_interrupt_requested(0)
+		:m_timer_sequence(0), app_quit_now(0),loop_level(0),retval(0), m_is_idle(0), m_idle_count(0), m_inActivate(0), m_interrupt_requested(0), m_epoll_fd(-1)
 	{
 		existing_loops.push_back(this);
 	}
@@ -278,9 +298,12 @@ class eTimer: iObject
 	long interval;
 	bool bSingleShot;
 	bool bActive;
+	int m_heap_index; // position in the timer heap of the context, -1 when not in it
+	unsigned int m_sequence; // order of timers with the same nextActivation
+	void *m_creator; // the caller of create, names the callback in eMainloopProfile
 	void activate();
 
-	eTimer(eMainloop *context): context(*context), bActive(false) { }
+	eTimer(eMainloop *context): context(*context), bActive(false), m_heap_index(-1), m_creator(0) { }
 public:
 	/**
 	 * \brief Constructs a timer.
@@ -288,7 +311,7 @@ public:
 	 * The timer is not yet active, it has to be started with \c start.
 	 * \param context The thread from which the signal should be emitted.
 	 */
-	static eTimer *create(eMainloop *context=eApp) { return new eTimer(context); }
+	static eTimer *create(eMainloop *context=eApp) __attribute__((noinline));
 	~eTimer() { if (bActive) stop(); }
 
 	PSignal0<void> timeout;
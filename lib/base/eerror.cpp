@@ -5,6 +5,11 @@
 #include <cstdlib>
 #include <cstring>
 #include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <semaphore.h>
+#include <sys/syscall.h>
+#include <asm/types.h>
 
 #include <string>
 
@@ -75,12 +80,427 @@ void DumpUnfreed()
 SigC::Connection logConnection;
 Signal2<void, int, const std::string&> logOutput;
 int logOutputConsole=1;
+int logLevel=lvlDebug;
 
 static pthread_mutex_t DebugLock =
 	PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP;
 
 extern void bsodFatal(const char *component);
 
+/*
+ * The messages are formatted by the logging thread into a ring of that
+ * thread and written by a writer thread, so logging doesn't wait for
+ * the console or the log buffer. Each thread has its own ring with one
+ * writer and one reader, so queueing a message takes no lock. The writer
+ * merges the rings by the global sequence number of the messages.
+ *
+ * A message longer than one entry continues in the following entries,
+ * which have the same sequence number, a message longer than the ring is
+ * written directly. When the ring of a thread stays full for a
+ * millisecond the thread drains the rings itself, when the writer holds
+ * them its messages are dropped and the number is written with the next
+ * drain. A line repeated by a thread within a second is only written
+ * once, followed by the number of repeats, eLogFlush writes the pending
+ * number too.
+ *
+ * The entries stay in the ring after they were written, eLogCrashdump
+ * writes the rings as they are:
+ *
+ *   char magic[8]          "E2LOGDMP"
+ *   __u32 version          1
+ *   __u32 entry_size       256
+ *   __u32 ring_entries     256
+ *   __u32 rings
+ *   rings * {
+ *     __u32 tid, head, tail, dropped
+ *     logEntry entries[ring_entries]   entry (head - 1) % ring_entries is the last one
+ *   }
+ *
+ * in native byte order.
+ */
+struct logEntry
+{
+	__u32 sequence;
+	__u32 time; // CLOCK_MONOTONIC in ms
+	__u8 level;
+	__u8 flags;
+	__u16 length;
+	char text[244];
+};
+
+enum { RING_ENTRIES = 256, entryNewline = 1, entryContinued = 2 };
+
+struct logRing
+{
+	logEntry entries[RING_ENTRIES];
+	volatile unsigned int head; // written by the thread
+	volatile unsigned int tail; // read by the writer
+	volatile unsigned int dropped;
+	volatile int orphaned; // the thread exited, the ring can be taken by a new thread
+	unsigned int dropped_reported; // only used by the writer
+	int tid;
+		/* the last line, only used by the thread */
+	unsigned int last_hash;
+	time_t last_time;
+	volatile int repeated; // also taken by eLogFlush
+	logRing *next;
+};
+
+static logRing *volatile rings;
+static __thread logRing *thread_ring;
+static pthread_key_t ring_key;
+static pthread_once_t writer_once = PTHREAD_ONCE_INIT;
+static volatile bool writer_running;
+static volatile int writer_idle;
+static sem_t writer_wakeup;
+static volatile unsigned int log_sequence;
+static pthread_mutex_t drain_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void orphanRing(void *ring)
+{
+	((logRing*)ring)->orphaned = 1;
+}
+
+static logRing *threadRing()
+{
+	if (thread_ring)
+		return thread_ring;
+	logRing *ring;
+	for (ring = rings; ring; ring = ring->next)
+		if (ring->orphaned && ring->tail == ring->head && __sync_bool_compare_and_swap(&ring->orphaned, 1, 0))
+			break;
+	if (!ring)
+	{
+		ring = (logRing*)calloc(1, sizeof(logRing));
+		if (!ring)
+			return 0;
+		do
+			ring->next = rings;
+		while (!__sync_bool_compare_and_swap(&rings, ring->next, ring));
+	}
+	ring->tid = syscall(SYS_gettid);
+	ring->last_hash = 0;
+	ring->repeated = 0;
+	pthread_setspecific(ring_key, ring);
+	return thread_ring = ring;
+}
+
+	/* writes the next message of ring to out, returns false when the ring is
+	   empty. logOutput is only called with signal set */
+static bool writeMessage(logRing *ring, std::string &out, bool signal)
+{
+	unsigned int tail = ring->tail;
+	if (tail == ring->head)
+		return false;
+	__sync_synchronize();
+	std::string text;
+	int level;
+	bool newline;
+	while (1)
+	{
+		const logEntry &e = ring->entries[tail++ % RING_ENTRIES];
+		text.append(e.text, e.length);
+		level = e.level;
+		newline = e.flags & entryNewline;
+		if (!(e.flags & entryContinued))
+			break;
+	}
+	__sync_synchronize();
+	ring->tail = tail;
+	if (newline)
+		text += '\n';
+	if (signal && logConnection.connected())
+	{
+		singleLock s(DebugLock);
+		logOutput(level, text);
+	}
+	if (logOutputConsole)
+		out += text;
+	return true;
+}
+
+	/* writes the queued messages of all rings in the order they were logged */
+static void drain(bool signal=true)
+{
+	std::string out;
+	while (1)
+	{
+		logRing *first = 0;
+		for (logRing *ring = rings; ring; ring = ring->next)
+		{
+			if (ring->dropped != ring->dropped_reported)
+			{
+				char buf[64];
+				unsigned int dropped = ring->dropped;
+				snprintf(buf, sizeof(buf), "[eLog] %u messages of thread %d dropped\n", dropped - ring->dropped_reported, ring->tid);
+				ring->dropped_reported = dropped;
+				out += buf;
+			}
+			if (ring->tail != ring->head)
+			{
+				__sync_synchronize();
+				if (!first || (int)(ring->entries[ring->tail % RING_ENTRIES].sequence - first->entries[first->tail % RING_ENTRIES].sequence) < 0)
+					first = ring;
+			}
+		}
+		if (!first)
+			break;
+		writeMessage(first, out, signal);
+		if (out.size() > 16384)
+		{
+			fwrite(out.data(), 1, out.size(), stderr);
+			out.clear();
+		}
+	}
+	if (!out.empty())
+		fwrite(out.data(), 1, out.size(), stderr);
+}
+
+static bool pending()
+{
+	for (logRing *ring = rings; ring; ring = ring->next)
+		if (ring->tail != ring->head)
+			return true;
+	return false;
+}
+
+static void *logWriter(void *)
+{
+	while (1)
+	{
+		{
+			singleLock s(drain_lock);
+			drain();
+		}
+		writer_idle = 1;
+		__sync_synchronize();
+		if (pending() && __sync_bool_compare_and_swap(&writer_idle, 1, 0))
+			continue;
+		while (sem_wait(&writer_wakeup) < 0 && errno == EINTR)
+			;
+	}
+	return 0;
+}
+
+static void flushAtExit()
+{
+	eLogFlush();
+}
+
+static void startWriter()
+{
+	pthread_t writer;
+	pthread_attr_t attr;
+	pthread_key_create(&ring_key, orphanRing);
+	sem_init(&writer_wakeup, 0, 0);
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	pthread_attr_setstacksize(&attr, 65536);
+	if (!pthread_create(&writer, &attr, logWriter, 0))
+	{
+		atexit(flushAtExit);
+		writer_running = true;
+	}
+	pthread_attr_destroy(&attr);
+}
+
+static unsigned int hashText(const char *text, int len, int level)
+{
+	unsigned int hash = 2166136261u ^ level;
+	for (int i = 0; i < len; ++i)
+		hash = (hash ^ (unsigned char)text[i]) * 16777619;
+	return hash;
+}
+
+static void writeDirect(int level, const char *text, int len, bool newline)
+{
+	std::string s(text, len);
+	if (newline)
+		s += '\n';
+	if (logConnection.connected())
+	{
+		singleLock l(DebugLock);
+		logOutput(level, s);
+	}
+	if (logOutputConsole)
+		fwrite(s.data(), 1, s.size(), stderr);
+}
+
+static void queue(logRing *ring, int level, const char *text, int len, bool newline)
+{
+	int count = len ? (len + sizeof(ring->entries[0].text) - 1) / sizeof(ring->entries[0].text) : 1;
+	if (count > RING_ENTRIES)
+	{
+		// doesn't fit into the ring, written after the queued messages.
+		// a logOutput slot of the writer can't wait for drain_lock
+		bool locked = !pthread_mutex_trylock(&drain_lock);
+		if (locked)
+			drain();
+		writeDirect(level, text, len, newline);
+		if (locked)
+			pthread_mutex_unlock(&drain_lock);
+		return;
+	}
+	unsigned int head = ring->head;
+		/* give the writer up to 1ms to make room, then drain the rings
+		   here. the writer holds drain_lock when it is slow itself or
+		   when this is a message logged by a logOutput slot, then the
+		   message is dropped */
+	for (int wait = 0; head - ring->tail + count > RING_ENTRIES; ++wait)
+	{
+		if (wait == 10)
+		{
+			if (pthread_mutex_trylock(&drain_lock))
+			{
+				__sync_add_and_fetch(&ring->dropped, 1);
+				return;
+			}
+			drain();
+			pthread_mutex_unlock(&drain_lock);
+			continue;
+		}
+		if (__sync_bool_compare_and_swap(&writer_idle, 1, 0))
+			sem_post(&writer_wakeup);
+		usleep(100);
+	}
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	unsigned int sequence = __sync_add_and_fetch(&log_sequence, 1);
+	for (int i = 0; i < count; ++i)
+	{
+		logEntry &e = ring->entries[head++ % RING_ENTRIES];
+		int n = len < (int)sizeof(e.text) ? len : sizeof(e.text);
+		e.sequence = sequence;
+		e.time = now.tv_sec * 1000 + now.tv_nsec / 1000000;
+		e.level = level;
+		e.flags = (i < count - 1) ? entryContinued : (newline ? entryNewline : 0);
+		e.length = n;
+		memcpy(e.text, text, n);
+		text += n;
+		len -= n;
+	}
+	__sync_synchronize();
+	ring->head = head;
+	if (__sync_bool_compare_and_swap(&writer_idle, 1, 0))
+		sem_post(&writer_wakeup);
+}
+
+static void logMessage(int level, const char *text, int len, bool newline)
+{
+	pthread_once(&writer_once, startWriter);
+	logRing *ring = writer_running ? threadRing() : 0;
+	if (!ring)
+	{
+		// no writer thread, write it here
+		writeDirect(level, text, len, newline);
+		return;
+	}
+
+	if (newline)
+	{
+		unsigned int hash = hashText(text, len, level);
+		time_t now = time(0);
+		if (hash == ring->last_hash && now - ring->last_time < 1)
+		{
+			__sync_add_and_fetch(&ring->repeated, 1);
+			return;
+		}
+		int repeated = __sync_lock_test_and_set(&ring->repeated, 0);
+		if (repeated)
+		{
+			char buf[64];
+			int n = snprintf(buf, sizeof(buf), "[eLog] last message repeated %d times", repeated);
+			queue(ring, level, buf, n, true);
+		}
+		ring->last_hash = hash;
+		ring->last_time = now;
+	}
+	queue(ring, level, text, len, newline);
+}
+
+	/* writes the repeat counts of the rings which are drained completely */
+static void drainRepeated(bool signal)
+{
+	std::string out;
+	for (logRing *ring = rings; ring; ring = ring->next)
+	{
+		if (ring->tail != ring->head || !ring->repeated)
+			continue;
+		int repeated = __sync_lock_test_and_set(&ring->repeated, 0);
+		if (!repeated)
+			continue;
+		char buf[64];
+		snprintf(buf, sizeof(buf), "[eLog] last message repeated %d times\n", repeated);
+		if (signal && logConnection.connected())
+		{
+			singleLock s(DebugLock);
+			logOutput(lvlDebug, buf);
+		}
+		if (logOutputConsole)
+			out += buf;
+	}
+	if (!out.empty())
+		fwrite(out.data(), 1, out.size(), stderr);
+}
+
+void eLogFlush(bool crash)
+{
+	if (!writer_running)
+		return;
+	bool locked = true;
+	if (crash)
+	{
+		// the writer might be the crashed thread or stuck in a logOutput
+		// slot. after 200ms the rings are drained anyway, only to the
+		// console
+		timespec timeout;
+		clock_gettime(CLOCK_REALTIME, &timeout);
+		timeout.tv_nsec += 200000000;
+		if (timeout.tv_nsec >= 1000000000)
+		{
+			timeout.tv_nsec -= 1000000000;
+			++timeout.tv_sec;
+		}
+		locked = !pthread_mutex_timedlock(&drain_lock, &timeout);
+	}
+	else
+		pthread_mutex_lock(&drain_lock);
+	drain(locked);
+	drainRepeated(locked);
+	if (locked)
+		pthread_mutex_unlock(&drain_lock);
+}
+
+static void writeAll(int fd, const void *data, size_t size)
+{
+	const char *p = (const char*)data;
+	while (size)
+	{
+		ssize_t n = ::write(fd, p, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return;
+		p += n;
+		size -= n;
+	}
+}
+
+void eLogCrashdump(int fd)
+{
+	__u32 header[4] = { 1, sizeof(logEntry), RING_ENTRIES, 0 };
+	for (logRing *ring = rings; ring; ring = ring->next)
+		++header[3];
+	writeAll(fd, "E2LOGDMP", 8);
+	writeAll(fd, header, sizeof(header));
+	for (logRing *ring = rings; ring && header[3]; ring = ring->next, --header[3])
+	{
+		__u32 state[4] = { (__u32)ring->tid, ring->head, ring->tail, ring->dropped };
+		writeAll(fd, state, sizeof(state));
+		writeAll(fd, ring->entries, sizeof(ring->entries));
+	}
+}
+
 void eFatal(const char* fmt, ...)
 {
 	char buf[1024];
@@ -88,6 +508,7 @@ void eFatal(const char* fmt, ...)
 	va_start(ap, fmt);
 	vsnprintf(buf, 1024, fmt, ap);
 	va_end(ap);
+	eLogFlush(true);
 	{
 		singleLock s(DebugLock);
 		logOutput(lvlFatal, "FATAL: " + std::string(buf) + "\n");
@@ -97,64 +518,59 @@ void eFatal(const char* fmt, ...)
 }
 
 #ifdef DEBUG
+#if LOG_MIN_LEVEL <= 1
 void eDebug(const char* fmt, ...)
 {
+	if (logLevel > lvlDebug)
+		return;
 	char buf[1024];
 	va_list ap;
 	va_start(ap, fmt);
-	vsnprintf(buf, 1024, fmt, ap);
+	int len = vsnprintf(buf, 1024, fmt, ap);
 	va_end(ap);
-	if (logConnection.connected()) {
-		singleLock s(DebugLock);
-		logOutput(lvlDebug, std::string(buf) + "\n");
-	}
-	if (logOutputConsole)
-		fprintf(stderr, "%s\n", buf);
+	logMessage(lvlDebug, buf, len < 1024 ? len : 1023, true);
 }
 
 void eDebugNoNewLine(const char* fmt, ...)
 {
+	if (logLevel > lvlDebug)
+		return;
 	char buf[1024];
 	va_list ap;
 	va_start(ap, fmt);
-	vsnprintf(buf, 1024, fmt, ap);
+	int len = vsnprintf(buf, 1024, fmt, ap);
 	va_end(ap);
-	if (logConnection.connected()) {
-		singleLock s(DebugLock);
-		logOutput(lvlDebug, buf);
-	}
-	if (logOutputConsole)
-		fprintf(stderr, "%s", buf);
+	logMessage(lvlDebug, buf, len < 1024 ? len : 1023, false);
 }
+#endif
 
+#if LOG_MIN_LEVEL <= 2
 void eWarning(const char* fmt, ...)
 {
+	if (logLevel > lvlWarning)
+		return;
 	char buf[1024];
 	va_list ap;
 	va_start(ap, fmt);
-	vsnprintf(buf, 1024, fmt, ap);
+	int len = vsnprintf(buf, 1024, fmt, ap);
 	va_end(ap);
-	if (logConnection.connected()) {
-		singleLock s(DebugLock);
-		logOutput(lvlWarning, std::string(buf) + "\n");
-	}
-	if (logOutputConsole)
-		fprintf(stderr, "%s\n", buf);
+	logMessage(lvlWarning, buf, len < 1024 ? len : 1023, true);
 }
+#endif
 #endif // DEBUG
 
 void ePythonOutput(const char *string)
 {
 #ifdef DEBUG
-	if (logConnection.connected()) {
-		singleLock s(DebugLock);
-		logOutput(lvlWarning, string);
-	}
-	if (logOutputConsole)
-		fwrite(string, 1, strlen(string), stderr);
+	logMessage(lvlWarning, string, strlen(string), false);
 #endif
 }
 
+void setLogLevel(int level)
+{
+	logLevel = level;
+}
+
 void eWriteCrashdump()
 {
 		/* implement me */
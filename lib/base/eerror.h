@@ -116,12 +116,17 @@ extern int logOutputConsole;
 void CHECKFORMAT eFatal(const char*, ...);
 enum { lvlDebug=1, lvlWarning=2, lvlFatal=4 };
 
-#ifdef DEBUG
+	/* the messages below LOG_MIN_LEVEL are not compiled in, the ones
+	   below logLevel are dropped before they are formatted */
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 1
+#endif
+extern int logLevel;
+
+#if defined(DEBUG) && LOG_MIN_LEVEL <= 1
     void CHECKFORMAT eDebug(const char*, ...);
     void CHECKFORMAT eDebugNoNewLine(const char*, ...);
-    void CHECKFORMAT eWarning(const char*, ...);
-    #define ASSERT(x) { if (!(x)) eFatal("%s:%d ASSERTION %s FAILED!", __FILE__, __LINE__, #x); }
-#else  // DEBUG
+#else
     inline void eDebug(const char* fmt, ...)
     {
     }
@@ -129,17 +134,34 @@ enum { lvlDebug=1, lvlWarning=2, lvlFatal=4 };
     inline void eDebugNoNewLine(const char* fmt, ...)
     {
     }
+#endif
 
+#if defined(DEBUG) && LOG_MIN_LEVEL <= 2
+    void CHECKFORMAT eWarning(const char*, ...);
+#else
     inline void eWarning(const char* fmt, ...)
     {
     }
+#endif
+
+#ifdef DEBUG
+    #define ASSERT(x) { if (!(x)) eFatal("%s:%d ASSERTION %s FAILED!", __FILE__, __LINE__, #x); }
+#else  // DEBUG
     #define ASSERT(x) do { } while (0)
 #endif //DEBUG
 
 void eWriteCrashdump();
 
+	/* writes all queued messages. with crash set it doesn't wait for
+	   the writer thread, which may be the one which crashed */
+void eLogFlush(bool crash=false);
+	/* writes the log rings of all threads to fd, see eerror.cpp for the
+	   format. only uses write(), so it can be called after a crash */
+void eLogCrashdump(int fd);
+
 #endif // SWIG
 
 void ePythonOutput(const char *);
+void setLogLevel(int level);
 
 #endif // __E_ERROR__
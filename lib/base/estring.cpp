@@ -2,6 +2,14 @@
 #include <cctype>
 #include <climits>
 #include <string>
+#include <vector>
+#include <string.h>
+#include <stdint.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include <lib/base/eerror.h>
 #include <lib/base/encoding.h>
 #include <lib/base/estring.h>
@@ -319,6 +327,62 @@ static inline unsigned int doVideoTexSuppl(int c1, int c2)
 	return 0;
 }
 
+// doVideoTexSuppl as table, indexed by (c1 - 0xC0) * 128 + c2. all second
+// characters are below 0x80
+static unsigned short videoTexSupplTable[16 * 128];
+
+static struct videoTexSupplInit
+{
+	videoTexSupplInit()
+	{
+		for (int c1 = 0; c1 < 16; ++c1)
+			for (int c2 = 0; c2 < 128; ++c2)
+				videoTexSupplTable[c1 * 128 + c2] = doVideoTexSuppl(0xC0 + c1, c2);
+	}
+} videoTexSupplInit;
+
+static inline unsigned int videoTexSuppl(unsigned char c1, unsigned char c2)
+{
+	if ((c1 & 0xF0) != 0xC0 || (c2 & 0x80))
+		return 0;
+	return videoTexSupplTable[(c1 & 0x0F) * 128 + c2];
+}
+
+// length of the run of ascii characters at data, they are copied as they
+// are. 0x00 ends the run, it is dropped by convertDVBUTF8
+static inline int asciiRun(const unsigned char *data, int len)
+{
+	int i = 0;
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+		if (_mm_movemask_epi8(v) | _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)))
+			break;
+	}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+	for (; i + 16 <= len; i += 16)
+	{
+		uint8x16_t v = vld1q_u8(data + i);
+		uint64x2_t stop = vreinterpretq_u64_u8(vorrq_u8(vcgeq_u8(v, vdupq_n_u8(0x80)), vceqq_u8(v, vdupq_n_u8(0))));
+		if (vgetq_lane_u64(stop, 0) | vgetq_lane_u64(stop, 1))
+			break;
+	}
+#else
+	for (; i + 4 <= len; i += 4)
+	{
+		uint32_t w;
+		memcpy(&w, data + i, 4);
+		if ((w | ((w - 0x01010101) & ~w)) & 0x80808080) // high bit set or zero byte
+			break;
+	}
+#endif
+	while (i < len && data[i] && data[i] < 0x80)
+		++i;
+	return i;
+}
+
 static inline unsigned int recode(unsigned char d, int cp)
 {
 	if (d < 0xA0)
@@ -431,22 +495,37 @@ std::string convertDVBUTF8(const unsigned char *data, int len, int table, int ts
 		table = 0;
 	}
 
-	unsigned char res[2048];
+	// all codes are below 0x10000, so every byte becomes 3 bytes utf-8 at most
+	int max = len > i ? 3 * (len - i) : 0;
+	char buf[2048];
+	std::vector<char> heap;
+	char *res = buf;
+	if (max > (int)sizeof(buf))
+	{
+		heap.resize(max);
+		res = &heap[0];
+	}
+
 	while (i < len)
 	{
+		if (table != 65 && data[i] < 0x80) // ascii is the same in all tables
+		{
+			int n = asciiRun(data + i, len - i);
+			memcpy(res + t, data + i, n);
+			t += n;
+			i += n ? n : 1; // 0x00 is dropped
+			continue;
+		}
 		unsigned long code=0;
-		if ( useTwoCharMapping && i+1 < len && (code=doVideoTexSuppl(data[i], data[i+1])) )
+		if ( useTwoCharMapping && i+1 < len && (code=videoTexSuppl(data[i], data[i+1])) )
 			i+=2;
-		if (!code) {
-			if (table == 65) { // unicode
-				if (i+1 < len) {
-					code=(data[i] << 8) | data[i+1];
-					i += 2;
-				}
-			}
-			else
-				code=recode(data[i++], table);
+		else if (table == 65) { // unicode
+			if (i+1 < len)
+				code=(data[i] << 8) | data[i+1];
+			i += 2;
 		}
+		else
+			code=recode(data[i++], table);
 		if (!code)
 			continue;
 				// Unicode->UTF8 encoding
@@ -456,25 +535,14 @@ std::string convertDVBUTF8(const unsigned char *data, int len, int table, int ts
 		{
 			res[t++]=(code>>6)|0xC0;
 			res[t++]=(code&0x3F)|0x80;
-		} else if (code < 0x10000) // three bytes mapping
+		} else // three bytes mapping
 		{
 			res[t++]=(code>>12)|0xE0;
 			res[t++]=((code>>6)&0x3F)|0x80;
 			res[t++]=(code&0x3F)|0x80;
-		} else
-		{
-			res[t++]=(code>>18)|0xF0;
-			res[t++]=((code>>12)&0x3F)|0x80;
-			res[t++]=((code>>6)&0x3F)|0x80;
-			res[t++]=(code&0x3F)|0x80;
-		}
-		if (t+4 > 2047)
-		{
-			eDebug("convertDVBUTF8 buffer to small.. break now");
-			break;
 		}
 	}
-	return std::string((char*)res, t);
+	return std::string(res, t);
 }
 
 std::string convertUTF8DVB(const std::string &string, int table)
@@ -16,6 +16,8 @@
 #define MAJORSD_	8
 #define MAJORMMCBLK	179
 #define LIMIT_FILESIZE_NOHDD	2*1024*1024*1024LL	// 2GBytes
+#define PREALLOC_MIN_CHUNK	16*1024*1024LL
+#define PREALLOC_MAX_CHUNK	256*1024*1024LL
 
 //FILE *f = fopen("/log.ts", "wb");
 static bool g_is_diskfull = false;
@@ -27,7 +29,18 @@ eFilePushThread::eFilePushThread(int io_prio_class, int io_prio_level, int block
 	m_sg = 0;
 	m_send_pvr_commit = 0;
 	m_stream_mode = 0;
+	m_fd_source = -1;
+	m_splice = false;
+	m_write_mode = m_active_write_mode = writeCached;
+	m_write_buffer_size = 0;
+	m_write_buffer = 0;
+	m_flush_threshold = 512*1024;
+	m_default_write_size = 1024*1024;
+	m_prealloc_chunk = 0;
+	m_allocated_end = m_write_end = 0;
+	m_preallocating = false;
 	m_blocksize = blocksize;
+	m_buffer = m_buffer_data;
 	flush();
 	enablePVRCommit(0);
 	CONNECT(m_messagepump.recv_msg, eFilePushThread::recvEvent);
@@ -43,7 +56,6 @@ void eFilePushThread::thread()
 {
 	setIoPrio(prio_class, prio);
 
-	off_t dest_pos = 0;
 	size_t bytes_read = 0;
 	
 	off_t current_span_offset = 0;
@@ -71,14 +83,23 @@ void eFilePushThread::thread()
 
 	struct stat tspath_st;
 	if (stat(m_tspath.c_str(), &tspath_st) == 0) {
+			/* disks take large writes best, the page cache of the small
+			   eMMC boxes should be freed early. Network filesystems are
+			   in between, large bursts stall the other traffic. */
 		if (major(tspath_st.st_dev) == MAJORSD_) {
 			eDebug("%s location on HDD!", m_tspath.c_str());
 			m_hdd_connected = true;
+			m_flush_threshold = 4*1024*1024;
+			m_default_write_size = 4*1024*1024;
 		} else if (major(tspath_st.st_dev) == MAJORMMCBLK) {
 			eDebug("%s location on eMMC!", m_tspath.c_str());
 			m_hdd_connected = false;
+			m_flush_threshold = 512*1024;
+			m_default_write_size = 1024*1024;
 		} else {
 			eDebug("%s location on other device", m_tspath.c_str());
+			m_flush_threshold = 1024*1024;
+			m_default_write_size = 2*1024*1024;
 		}
 	} else {
 		eDebug("stat failed!");
@@ -95,8 +116,14 @@ void eFilePushThread::thread()
 	
 	hasStarted();
 
+	startWriteBuffer();
+	startPreallocation();
+
+	bool spliced = m_splice && m_active_write_mode == writeCached && m_fd_source >= 0 && !m_sg && !m_send_pvr_commit
+		&& splicePush(written_since_last_sync);
+
 		/* m_stop must be evaluated after each syscall. */
-	while (!m_stop)
+	while (!spliced && !m_stop)
 	{
 			/* first try flushing the bufptr */
 		if (m_buf_start != m_buf_end)
@@ -149,57 +176,29 @@ void eFilePushThread::thread()
 				/* now write out data. it will be 'aligned' (according to filterRecordData). 
 				   absolutely forbidden is to return EINTR and consume a non-aligned number of bytes. 
 				*/
-			int w = write(m_fd_dest, m_buffer + m_buf_start, m_buf_end - m_buf_start);
+			int w = writeData(m_buffer + m_buf_start, m_buf_end - m_buf_start);
 //			fwrite(m_buffer + m_buf_start, 1, m_buf_end - m_buf_start, f);
 //			eDebug("wrote %d bytes", w);
 			if (w <= 0)
 			{
 				if (w < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY))
 					continue;
-				eDebug("eFilePushThread WRITE ERROR");
-				sendEvent(evtWriteError);
-
-				struct statfs fs;
-				if (statfs(m_tspath.c_str(), &fs) < 0) {
-					eDebug("statfs failed!");
-				}
-				if ((off_t)fs.f_bavail < 1) {
-					eDebug("not enough diskspace!");
-					g_is_diskfull = true;
-				}
+				writeError();
 				break;
 				// ... we would stop the thread
 			}
 
 			written_since_last_sync += w;
-
-			if (written_since_last_sync >= 512*1024)
-			{
-				int toflush = written_since_last_sync > 2*1024*1024 ?
-					2*1024*1024 : written_since_last_sync &~ 4095; // write max 2MB at once
-				dest_pos = lseek(m_fd_dest, 0, SEEK_CUR);
-				dest_pos -= toflush;
-				posix_fadvise(m_fd_dest, dest_pos, toflush, POSIX_FADV_DONTNEED);
-				written_since_last_sync -= toflush;
-			}
+			dropWritten(written_since_last_sync);
+			allocateAhead(w);
 
 //			printf("FILEPUSH: wrote %d bytes\n", w);
 			m_buf_start += w;
 			continue;
 		}
 
-		if (!m_hdd_connected) {
-			struct stat limit_filesize;
-			if (fstat(m_fd_dest, &limit_filesize) == 0) {
-				if (limit_filesize.st_size > LIMIT_FILESIZE_NOHDD) {
-					eDebug("eFilePushThread %lld > %lld LIMIT FILESIZE", limit_filesize.st_size, LIMIT_FILESIZE_NOHDD);
-					sendEvent(evtWriteError);
-
-					g_is_diskfull = true;
-					break;
-				}
-			}
-		}
+		if (fileSizeLimitReached())
+			break;
 
 			/* now fill our buffer. */
 			
@@ -211,7 +210,7 @@ void eFilePushThread::thread()
 			bytes_read = 0;
 		}
 
-		size_t maxread = sizeof(m_buffer);
+		size_t maxread = BUFFER_SIZE;
 		
 			/* if we have a source span, don't read past the end */
 		if (m_sg && maxread > current_span_remaining)
@@ -225,7 +224,10 @@ void eFilePushThread::thread()
 		m_buf_end = 0;
 
 		if (maxread)
+		{
+			m_buffer = nextBuffer(m_buffer);
 			m_buf_end = m_source->read(m_current_position, m_buffer, maxread);
+		}
 
 		if (m_buf_end < 0)
 		{
@@ -294,17 +296,359 @@ void eFilePushThread::thread()
 			g_is_diskfull = false;
 		}
 	}
+	stopWriteBuffer();
+	stopPreallocation();
 	fdatasync(m_fd_dest);
 
 	eDebug("FILEPUSH THREAD STOP");
 }
 
+void eFilePushThread::startWriteBuffer()
+{
+	m_active_write_mode = m_write_mode;
+	if (m_active_write_mode == writeCached)
+		return;
+
+	m_write_size = m_write_buffer_size ? m_write_buffer_size : m_default_write_size;
+	m_write_size = (m_write_size + 4095) & ~4095;
+	void *buffer;
+	if (posix_memalign(&buffer, 4096, m_write_size))
+	{
+		eDebug("[eFilePushThread] no memory for a %d byte write buffer, writing through the page cache", m_write_size);
+		m_active_write_mode = writeCached;
+		return;
+	}
+	m_write_buffer = (unsigned char*)buffer;
+	m_write_fill = m_write_done = 0;
+	m_write_pos = lseek(m_fd_dest, 0, SEEK_CUR);
+	m_writeback_pos = m_writeback_len = 0;
+
+	if (m_active_write_mode == writeDirect)
+	{
+		int flags = fcntl(m_fd_dest, F_GETFL);
+		if (m_write_pos < 0 || (m_write_pos & 4095))
+		{
+			eDebug("[eFilePushThread] file position %lld not aligned for O_DIRECT, using write behind", (long long)m_write_pos);
+			m_active_write_mode = writeBehind;
+		}
+		else if (flags < 0 || fcntl(m_fd_dest, F_SETFL, flags | O_DIRECT) < 0)
+		{
+			eDebug("[eFilePushThread] O_DIRECT not supported (%m), using write behind");
+			m_active_write_mode = writeBehind;
+		}
+	}
+	eDebug("[eFilePushThread] %s with a %d byte buffer",
+		m_active_write_mode == writeDirect ? "direct I/O" : "write behind", m_write_size);
+}
+
+	/* like write, returns how much was taken. Only full buffers are written,
+	   so with O_DIRECT all writes but the last are aligned. */
+int eFilePushThread::writeData(const unsigned char *data, int len)
+{
+	if (m_active_write_mode == writeCached)
+		return write(m_fd_dest, data, len);
+
+	if (m_write_fill == m_write_size && flushWriteBuffer(false) < 0)
+		return -1;
+	if (len > m_write_size - m_write_fill)
+		len = m_write_size - m_write_fill;
+	memcpy(m_write_buffer + m_write_fill, data, len);
+	m_write_fill += len;
+	return len;
+}
+
+int eFilePushThread::flushWriteBuffer(bool final)
+{
+	int len = m_write_fill;
+		/* O_DIRECT needs whole blocks, the tail is written through the page cache */
+	if (final && m_active_write_mode == writeDirect)
+		len &= ~4095;
+
+	while (m_write_done < len)
+	{
+		int w = write(m_fd_dest, m_write_buffer + m_write_done, len - m_write_done);
+		if (w < 0 && errno == EINTR && final)
+			continue;
+		if (w <= 0)
+			return -1;
+		m_write_done += w;
+	}
+
+	if (m_active_write_mode == writeDirect && len < m_write_fill)
+	{
+		int flags = fcntl(m_fd_dest, F_GETFL);
+		fcntl(m_fd_dest, F_SETFL, flags & ~O_DIRECT);
+		m_active_write_mode = writeBehind;
+		while (m_write_done < m_write_fill)
+		{
+			int w = write(m_fd_dest, m_write_buffer + m_write_done, m_write_fill - m_write_done);
+			if (w < 0 && errno == EINTR)
+				continue;
+			if (w <= 0)
+				return -1;
+			m_write_done += w;
+		}
+		len = m_write_fill;
+	}
+
+	if (m_active_write_mode == writeBehind)
+	{
+			/* start writing this buffer back, wait for the previous one and drop it */
+		sync_file_range(m_fd_dest, m_write_pos, len, SYNC_FILE_RANGE_WRITE);
+		if (m_writeback_len)
+		{
+			sync_file_range(m_fd_dest, m_writeback_pos, m_writeback_len,
+				SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+			posix_fadvise(m_fd_dest, m_writeback_pos, m_writeback_len, POSIX_FADV_DONTNEED);
+		}
+		m_writeback_pos = m_write_pos;
+		m_writeback_len = len;
+		if (final)
+		{
+			sync_file_range(m_fd_dest, m_writeback_pos, m_writeback_len,
+				SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+			posix_fadvise(m_fd_dest, m_writeback_pos, m_writeback_len, POSIX_FADV_DONTNEED);
+			m_writeback_len = 0;
+		}
+	}
+
+	m_write_pos += len;
+	m_write_fill = m_write_done = 0;
+	return 0;
+}
+
+void eFilePushThread::stopWriteBuffer()
+{
+	if (!m_write_buffer)
+		return;
+	if (flushWriteBuffer(true) < 0)
+		writeError();
+	if (m_active_write_mode == writeDirect)
+	{
+		int flags = fcntl(m_fd_dest, F_GETFL);
+		fcntl(m_fd_dest, F_SETFL, flags & ~O_DIRECT);
+	}
+	free(m_write_buffer);
+	m_write_buffer = 0;
+}
+
+void eFilePushThread::startPreallocation()
+{
+	m_preallocating = false;
+	if (!m_prealloc_chunk)
+		return;
+	m_write_end = lseek(m_fd_dest, 0, SEEK_CUR);
+	if (m_write_end < 0)
+		return;
+	m_allocated_end = m_write_end;
+	m_preallocating = true;
+	allocateAhead(0);
+}
+
+	/* keeps at least half a chunk reserved in front of the data written.
+	   KEEP_SIZE leaves the file size alone, so readers of a growing file
+	   (timeshift, playback while recording) don't see the reserved space. */
+void eFilePushThread::allocateAhead(size_t written)
+{
+	if (!m_preallocating)
+		return;
+	m_write_end += written;
+	if (m_write_end + m_prealloc_chunk / 2 < m_allocated_end)
+		return;
+	off_t start = m_allocated_end > m_write_end ? m_allocated_end : m_write_end;
+	if (fallocate(m_fd_dest, FALLOC_FL_KEEP_SIZE, start, m_prealloc_chunk) < 0)
+	{
+		if (errno == EINTR)
+			return; // again after the next write
+			/* the writes will notice when the disk is full */
+		eDebug("[eFilePushThread] preallocation failed (%m), not preallocating anymore");
+		stopPreallocation();
+		return;
+	}
+	m_allocated_end = start + m_prealloc_chunk;
+}
+
+void eFilePushThread::stopPreallocation()
+{
+	if (!m_preallocating)
+		return;
+	m_preallocating = false;
+	struct stat s;
+		/* truncating to the size frees the blocks reserved behind it */
+	if (fstat(m_fd_dest, &s) == 0 && ftruncate(m_fd_dest, s.st_size) < 0)
+		eDebug("[eFilePushThread] freeing the preallocated space failed (%m)");
+}
+
+	/* returns false when the source can't splice, nothing was consumed then */
+bool eFilePushThread::splicePush(size_t &written_since_last_sync)
+{
+	int data_pipe[2], tee_pipe[2];
+	if (pipe(data_pipe) < 0)
+	{
+		eDebug("[eFilePushThread] pipe failed (%m), not using splice");
+		return false;
+	}
+	if (pipe(tee_pipe) < 0)
+	{
+		eDebug("[eFilePushThread] pipe failed (%m), not using splice");
+		::close(data_pipe[0]);
+		::close(data_pipe[1]);
+		return false;
+	}
+
+		/* both pipes have the same default size, so a chunk always fits into
+		   the empty tee pipe and it can be read into m_buffer at once */
+	size_t chunk = BUFFER_SIZE - BUFFER_SIZE % m_blocksize;
+	bool first = true;
+	size_t dummy = 0;
+
+	while (!m_stop)
+	{
+		if (fileSizeLimitReached())
+			break;
+
+		ssize_t r = splice(m_fd_source, 0, data_pipe[1], 0, chunk, SPLICE_F_MOVE | SPLICE_F_MORE);
+		if (r < 0)
+		{
+			if (first && errno == EINVAL)
+			{
+				eDebug("[eFilePushThread] source can't splice, using read/write");
+				::close(data_pipe[0]);
+				::close(data_pipe[1]);
+				::close(tee_pipe[0]);
+				::close(tee_pipe[1]);
+				return false;
+			}
+			if (errno == EINTR || errno == EBUSY || errno == EAGAIN)
+				continue;
+			if (errno == EOVERFLOW)
+			{
+				eWarning("OVERFLOW while recording");
+				continue;
+			}
+			eDebug("eFilePushThread *splice error* (%m) - not yet handled");
+			r = 0;
+		}
+		first = false;
+
+		if (r == 0)
+		{
+			sendEvent(evtEOF);
+			if (m_stream_mode)
+			{
+				eDebug("reached EOF, but we are in stream mode. delaying 1 second.");
+				sleep(1);
+				continue;
+			}
+			break;
+		}
+		m_current_position += r;
+
+			/* the parser gets a copy, tee only references the pages of the pipe */
+		ssize_t t;
+		while ((t = tee(data_pipe[0], tee_pipe[1], r, 0)) < 0 && errno == EINTR)
+			;
+		if (t != r)
+			eDebug("[eFilePushThread] tee copied %zd of %zd bytes (%m)", t, r);
+		while (t > 0)
+		{
+			m_buffer = nextBuffer(m_buffer);
+			ssize_t n = ::read(tee_pipe[0], m_buffer, t);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				break;
+			filterRecordData(m_buffer, n, dummy);
+			t -= n;
+		}
+
+			/* the data left in the pipe is lost when we are stopped now,
+			   just like the buffer of the read/write loop */
+		while (r > 0 && !m_stop)
+		{
+			ssize_t w = splice(data_pipe[0], 0, m_fd_dest, 0, r, SPLICE_F_MOVE | SPLICE_F_MORE);
+			if (w < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY))
+				continue;
+			if (w <= 0)
+				break;
+			r -= w;
+			written_since_last_sync += w;
+			dropWritten(written_since_last_sync);
+			allocateAhead(w);
+		}
+		if (r > 0 && !m_stop)
+		{
+			writeError();
+			break;
+		}
+
+		if (g_is_diskfull) {
+			sendEvent(evtUser+3);
+			g_is_diskfull = false;
+		}
+	}
+
+	::close(data_pipe[0]);
+	::close(data_pipe[1]);
+	::close(tee_pipe[0]);
+	::close(tee_pipe[1]);
+	return true;
+}
+
+void eFilePushThread::writeError()
+{
+	eDebug("eFilePushThread WRITE ERROR");
+	sendEvent(evtWriteError);
+
+	struct statfs fs;
+	if (statfs(m_tspath.c_str(), &fs) < 0) {
+		eDebug("statfs failed!");
+	}
+	if ((off_t)fs.f_bavail < 1) {
+		eDebug("not enough diskspace!");
+		g_is_diskfull = true;
+	}
+}
+
+bool eFilePushThread::fileSizeLimitReached()
+{
+	if (!m_hdd_connected) {
+		struct stat limit_filesize;
+		if (fstat(m_fd_dest, &limit_filesize) == 0) {
+			if (limit_filesize.st_size > LIMIT_FILESIZE_NOHDD) {
+				eDebug("eFilePushThread %lld > %lld LIMIT FILESIZE", limit_filesize.st_size, LIMIT_FILESIZE_NOHDD);
+				sendEvent(evtWriteError);
+
+				g_is_diskfull = true;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+	/* drops the written data from the page cache, only used with writeCached */
+void eFilePushThread::dropWritten(size_t &written_since_last_sync)
+{
+	if (m_active_write_mode != writeCached)
+		return;
+	if (written_since_last_sync >= m_flush_threshold)
+	{
+		int toflush = written_since_last_sync > 4*m_flush_threshold ?
+			4*m_flush_threshold : written_since_last_sync &~ 4095; // write max 4 thresholds at once
+		off_t dest_pos = lseek(m_fd_dest, 0, SEEK_CUR);
+		dest_pos -= toflush;
+		posix_fadvise(m_fd_dest, dest_pos, toflush, POSIX_FADV_DONTNEED);
+		written_since_last_sync -= toflush;
+	}
+}
+
 void eFilePushThread::start(int fd, int fd_dest)
 {
 	eRawFile *f = new eRawFile();
 	ePtr<iTsSource> source = f;
 	f->setfd(fd);
-	start(source, fd_dest);
+	startPush(source, fd, fd_dest);
 }
 
 int eFilePushThread::start(const char *file, int fd_dest)
@@ -313,13 +657,19 @@ int eFilePushThread::start(const char *file, int fd_dest)
 	ePtr<iTsSource> source = f;
 	if (f->open(file) < 0)
 		return -1;
-	start(source, fd_dest);
+	startPush(source, -1, fd_dest);
 	return 0;
 }
 
 void eFilePushThread::start(ePtr<iTsSource> &source, int fd_dest)
+{
+	startPush(source, -1, fd_dest);
+}
+
+void eFilePushThread::startPush(ePtr<iTsSource> &source, int fd_source, int fd_dest)
 {
 	m_source = source;
+	m_fd_source = fd_source;
 	m_fd_dest = fd_dest;
 	m_current_position = 0;
 	resume();
@@ -379,6 +729,35 @@ void eFilePushThread::setScatterGather(iFilePushScatterGather *sg)
 	m_sg = sg;
 }
 
+void eFilePushThread::enableSplice(bool s)
+{
+	m_splice = s;
+}
+
+void eFilePushThread::setWriteMode(int mode, int buffersize)
+{
+	m_write_mode = mode;
+	m_write_buffer_size = buffersize;
+}
+
+void eFilePushThread::setPreallocation(int bitrate, int duration)
+{
+	if (bitrate <= 0)
+	{
+		m_prealloc_chunk = 0;
+		return;
+	}
+		/* a 16th of the recording, so the file ends up in about 16
+		   extents, and the unused tail of an early stop stays small */
+	off_t chunk = (off_t)bitrate * 1000 / 8 * (duration > 0 ? duration : 0) / 16;
+	if (chunk < PREALLOC_MIN_CHUNK)
+		chunk = PREALLOC_MIN_CHUNK;
+	else if (chunk > PREALLOC_MAX_CHUNK)
+		chunk = PREALLOC_MAX_CHUNK;
+	m_prealloc_chunk = chunk & ~(1024*1024LL - 1);
+	eDebug("[eFilePushThread] preallocating in chunks of %lldMB", (long long)m_prealloc_chunk >> 20);
+}
+
 void eFilePushThread::sendEvent(int evt)
 {
 	m_messagepump.send(evt);
@@ -423,3 +802,8 @@ int eFilePushThread::filterRecordData(const unsigned char *data, int len, size_t
 {
 	return len;
 }
+
+unsigned char *eFilePushThread::nextBuffer(unsigned char *buffer)
+{
+	return buffer;
+}
@@ -40,6 +40,35 @@ public:
 	void setTSPath(const std::string);
 	
 	void setScatterGather(iFilePushScatterGather *);
+
+		/* splice mode moves the data from a source fd to the destination
+		   through a pipe, without copying it to userspace. filterRecordData
+		   gets a tee'd copy of the data, in the chunks it arrives, and must
+		   pass all of it. Without a source fd, with scatter gather or when
+		   the source can't splice, read and write are used. */
+	void enableSplice(bool);
+
+	enum { writeCached, writeBehind, writeDirect };
+		/* writeCached writes through the page cache and drops the written
+		   data from it every 512kB to 4MB, depending on the device.
+		   writeBehind collects the data in an aligned buffer of buffersize
+		   bytes (0: 1 to 4MB, depending on the device) and writes it at
+		   once. It starts the writeback of each buffer with
+		   sync_file_range and waits for the previous one before dropping
+		   it from the page cache.
+		   writeDirect writes the buffer with O_DIRECT, bypassing the page
+		   cache. When the filesystem doesn't support it, writeBehind is
+		   used. Both disable splice mode. */
+	void setWriteMode(int mode, int buffersize=0);
+
+		/* reserves the space of the destination file with fallocate in
+		   chunks ahead of the writes, so a long recording gets a few
+		   large extents instead of the many small ones of the appends.
+		   The chunk size is taken from the expected size of bitrate
+		   (kbit/s) and duration (s), a duration of 0 is unknown. The
+		   space reserved behind the end of the file is freed when the
+		   thread stops. A bitrate of 0 disables it. */
+	void setPreallocation(int bitrate, int duration);
 	
 	enum { evtEOF, evtReadError, evtWriteError, evtUser };
 	Signal1<void,int> m_event;
@@ -51,12 +80,30 @@ public:
 	void sendEvent(int evt);
 protected:
 	virtual int filterRecordData(const unsigned char *data, int len, size_t &current_span_remaining);
+
+	enum { BUFFER_SIZE = 65536 };
+		/* called before data is read into buffer, returns the buffer of
+		   BUFFER_SIZE bytes to read into. The data of buffer was written
+		   already. A filter which keeps references to the data it got in
+		   filterRecordData returns another buffer while it still uses
+		   this one, the default keeps the buffer. */
+	virtual unsigned char *nextBuffer(unsigned char *buffer);
 private:
 	iFilePushScatterGather *m_sg;
 	int m_stop;
-	unsigned char m_buffer[65536];
+	unsigned char m_buffer_data[BUFFER_SIZE];
+	unsigned char *m_buffer;
 	int m_buf_start, m_buf_end, m_filter_end;
-	int m_fd_dest;
+	int m_fd_source, m_fd_dest;
+	bool m_splice;
+	int m_write_mode, m_write_buffer_size;
+	int m_active_write_mode; // m_write_mode, or writeBehind when O_DIRECT failed
+	unsigned char *m_write_buffer;
+	int m_write_size, m_write_fill, m_write_done;
+	off_t m_write_pos, m_writeback_pos, m_writeback_len;
+	size_t m_flush_threshold, m_default_write_size;
+	off_t m_prealloc_chunk, m_allocated_end, m_write_end;
+	bool m_preallocating;
 	int m_send_pvr_commit;
 	int m_stream_mode;
 	int m_blocksize;
@@ -71,6 +118,18 @@ private:
 
 	void recvEvent(const int &evt);
 	void defaultTSPath(bool);
+	void startPush(ePtr<iTsSource> &source, int sourcefd, int destfd);
+	bool splicePush(size_t &written_since_last_sync);
+	void writeError();
+	bool fileSizeLimitReached();
+	void dropWritten(size_t &written_since_last_sync);
+	void startWriteBuffer();
+	int writeData(const unsigned char *data, int len);
+	int flushWriteBuffer(bool final);
+	void stopWriteBuffer();
+	void startPreallocation();
+	void allocateAhead(size_t written);
+	void stopPreallocation();
 };
 
 #endif
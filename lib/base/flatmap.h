@@ -0,0 +1,132 @@
+#ifndef __lib_base_flatmap_h
+#define __lib_base_flatmap_h
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+/**
+ * \brief A std::map like container backed by one sorted std::vector.
+ *
+ * Lookups are binary searches, inserts and erases move the tail of the
+ * vector. This is a good trade for small to medium sized maps which are
+ * read much more often than they are written (like the per service EPG
+ * indices): there is no per node allocation and no per node pointer overhead.
+ *
+ * Unlike std::map every insert or erase invalidates all iterators behind
+ * the modified position, so use the iterator returned by erase() instead
+ * of the erase(it++) idiom.
+ */
+template <class K, class V>
+class eFlatMap
+{
+public:
+	typedef K key_type;
+	typedef V mapped_type;
+	typedef std::pair<K, V> value_type;
+	typedef typename std::vector<value_type>::iterator iterator;
+	typedef typename std::vector<value_type>::const_iterator const_iterator;
+	typedef typename std::vector<value_type>::size_type size_type;
+private:
+	std::vector<value_type> m_data;
+	struct key_less
+	{
+		bool operator()(const value_type &a, const K &b) const { return a.first < b; }
+		bool operator()(const K &a, const value_type &b) const { return a < b.first; }
+		bool operator()(const value_type &a, const value_type &b) const { return a.first < b.first; }
+	};
+public:
+	iterator begin() { return m_data.begin(); }
+	iterator end() { return m_data.end(); }
+	const_iterator begin() const { return m_data.begin(); }
+	const_iterator end() const { return m_data.end(); }
+	size_type size() const { return m_data.size(); }
+	size_type capacity() const { return m_data.capacity(); }
+	bool empty() const { return m_data.empty(); }
+	void reserve(size_type n) { m_data.reserve(n); }
+	void clear() { std::vector<value_type>().swap(m_data); }
+
+	iterator lower_bound(const K &k) { return std::lower_bound(m_data.begin(), m_data.end(), k, key_less()); }
+	iterator upper_bound(const K &k) { return std::upper_bound(m_data.begin(), m_data.end(), k, key_less()); }
+	const_iterator lower_bound(const K &k) const { return std::lower_bound(m_data.begin(), m_data.end(), k, key_less()); }
+	const_iterator upper_bound(const K &k) const { return std::upper_bound(m_data.begin(), m_data.end(), k, key_less()); }
+
+	iterator find(const K &k)
+	{
+		iterator it = lower_bound(k);
+		return (it != m_data.end() && !(k < it->first)) ? it : m_data.end();
+	}
+	const_iterator find(const K &k) const
+	{
+		const_iterator it = lower_bound(k);
+		return (it != m_data.end() && !(k < it->first)) ? it : m_data.end();
+	}
+
+	std::pair<iterator, bool> insert(const value_type &v)
+	{
+		iterator it = lower_bound(v.first);
+		if (it != m_data.end() && !(v.first < it->first))
+			return std::pair<iterator, bool>(it, false);
+		return std::pair<iterator, bool>(m_data.insert(it, v), true);
+	}
+
+		/* the hint is used when it is the right place, which is the common
+		   case when sorted data (EIT sections, cache files) is inserted */
+	iterator insert(iterator hint, const value_type &v)
+	{
+		if ((hint == m_data.end() || v.first < hint->first) &&
+			(hint == m_data.begin() || (hint-1)->first < v.first))
+			return m_data.insert(hint, v);
+		return insert(v).first;
+	}
+
+	V &operator[](const K &k)
+	{
+		iterator it = lower_bound(k);
+		if (it == m_data.end() || k < it->first)
+			it = m_data.insert(it, value_type(k, V()));
+		return it->second;
+	}
+
+	iterator erase(iterator it) { return m_data.erase(it); }
+	iterator erase(iterator first, iterator last) { return m_data.erase(first, last); }
+	size_type erase(const K &k)
+	{
+		iterator it = find(k);
+		if (it == m_data.end())
+			return 0;
+		m_data.erase(it);
+		return 1;
+	}
+
+		/* removes all entries for which pred(entry) is true in one pass.
+		   pred is called exactly once per entry, in key order.
+		   returns the number of removed entries */
+	template <class P> size_type remove_if(P pred)
+	{
+		iterator out = m_data.begin();
+		for (iterator it = m_data.begin(); it != m_data.end(); ++it)
+			if (!pred(*it))
+				*out++ = *it;
+		size_type n = m_data.end() - out;
+		m_data.erase(out, m_data.end());
+		return n;
+	}
+
+		/* bulk loading: append in any order, then sort() once.
+		   the keys must be unique */
+	void push_back(const value_type &v) { m_data.push_back(v); }
+	void sort() { std::sort(m_data.begin(), m_data.end(), key_less()); }
+
+		/* give back memory after lots of erases */
+	void compact()
+	{
+		if (m_data.capacity() > 2 * m_data.size() + 16)
+			std::vector<value_type>(m_data).swap(m_data);
+	}
+
+		/* memory used by the index itself */
+	size_type memoryUsage() const { return m_data.capacity() * sizeof(value_type); }
+};
+
+#endif
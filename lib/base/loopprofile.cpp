@@ -0,0 +1,373 @@
+#include <lib/base/loopprofile.h>
+#include <lib/base/eerror.h>
+#include <lib/base/elock.h>
+#include <lib/python/connections.h>
+
+#include <map>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <sys/syscall.h>
+
+volatile int eMainloopProfile::enabled;
+
+static volatile sig_atomic_t dump_requested;
+
+static const long long bucket_limit[eMainloopProfile::BUCKETS - 1] =
+	{ 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000 };
+
+static const char *kind_name[] = { "timer", "notifier", "poll" };
+
+struct callbackStat
+{
+	std::string name;
+	int kind;
+	unsigned int calls;
+	long long total, python, max; // usec
+	unsigned int histogram[eMainloopProfile::BUCKETS];
+	callbackStat(const std::string &name, int kind)
+		:name(name), kind(kind), calls(0), total(0), python(0), max(0)
+	{
+		memset(histogram, 0, sizeof(histogram));
+	}
+};
+
+struct traceEvent
+{
+	long long start, duration, python; // usec
+	int stat;
+	int tid;
+};
+
+	/* the callbacks running in this thread, mainloops may be nested */
+struct frame
+{
+	timespec start;
+	long long python;
+};
+enum { MAX_DEPTH = 16 };
+static __thread frame frames[MAX_DEPTH];
+static __thread int depth;
+static __thread int thread_id;
+
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<callbackStat> stats;
+static std::map<std::string, int> stat_index;
+static std::map<const void*, std::string> creator_names;
+static std::vector<traceEvent> trace;
+static unsigned int trace_count; // all events, the last TRACE_EVENTS are in trace
+
+static inline long long usec(const timespec &t)
+{
+	return (long long)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+static inline long long usecSince(const timespec &start)
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return usec(now) - usec(start);
+}
+
+static void appendAttr(std::string &name, ePyObject o, const char *attr)
+{
+	ePyObject s = PyObject_GetAttrString(o, attr);
+	if (s && PyString_Check(s))
+	{
+		if (!name.empty())
+			name += '.';
+		name += PyString_AS_STRING(s);
+	}
+	else
+		PyErr_Clear();
+	Py_XDECREF(s);
+}
+
+static void appendPythonName(std::string &name, ePyObject callable)
+{
+	std::string n;
+	if (PyMethod_Check(callable))
+	{
+		PyObject *method = callable;
+		ePyObject func = PyMethod_GET_FUNCTION(method);
+		appendAttr(n, func, "__module__");
+		ePyObject cls = PyMethod_GET_CLASS(method);
+		if (cls)
+			appendAttr(n, cls, "__name__");
+		appendAttr(n, func, "__name__");
+	}
+	else if (PyFunction_Check(callable))
+	{
+		appendAttr(n, callable, "__module__");
+		appendAttr(n, callable, "__name__");
+	}
+	else
+		n = Py_TYPE((PyObject*)callable)->tp_name;
+	if (!name.empty())
+		name += ", ";
+	name += n;
+}
+
+	/* the function the creator address is in, from the dynamic symbols,
+	   else the file and offset for addr2line */
+static const std::string &creatorName(const void *creator)
+{
+	std::map<const void*, std::string>::iterator it = creator_names.find(creator);
+	if (it != creator_names.end())
+		return it->second;
+	char buf[512];
+	Dl_info info;
+	bool found = creator && dladdr(creator, &info);
+	if (found && info.dli_sname)
+	{
+		int status;
+		char *demangled = abi::__cxa_demangle(info.dli_sname, 0, 0, &status);
+		snprintf(buf, sizeof(buf), "%s+0x%lx", demangled ? demangled : info.dli_sname,
+			(unsigned long)((const char*)creator - (const char*)info.dli_saddr));
+		free(demangled);
+	}
+	else if (found && info.dli_fname)
+	{
+		const char *file = strrchr(info.dli_fname, '/');
+		snprintf(buf, sizeof(buf), "%s+0x%lx", file ? file + 1 : info.dli_fname,
+			(unsigned long)((const char*)creator - (const char*)info.dli_fbase));
+	}
+	else
+		snprintf(buf, sizeof(buf), "%p", creator);
+	return creator_names[creator] = buf;
+}
+
+static void record(const std::string &name, int kind, const timespec &start, long long duration, long long python)
+{
+	singleLock s(profile_lock);
+	std::map<std::string, int>::iterator it = stat_index.find(name);
+	int index;
+	if (it == stat_index.end())
+	{
+		index = stats.size();
+		stats.push_back(callbackStat(name, kind));
+		stat_index[name] = index;
+	}
+	else
+		index = it->second;
+
+	callbackStat &st = stats[index];
+	++st.calls;
+	st.total += duration;
+	st.python += python;
+	if (duration > st.max)
+		st.max = duration;
+	int bucket = 0;
+	while (bucket < eMainloopProfile::BUCKETS - 1 && duration >= bucket_limit[bucket])
+		++bucket;
+	++st.histogram[bucket];
+
+	if (kind == eMainloopProfile::Poll && !bucket) // don't fill the trace with polls which didn't wait
+		return;
+	if (trace.empty())
+		trace.resize(eMainloopProfile::TRACE_EVENTS);
+	traceEvent &ev = trace[trace_count++ % eMainloopProfile::TRACE_EVENTS];
+	ev.start = usec(start);
+	ev.duration = duration;
+	ev.python = python;
+	ev.stat = index;
+	if (!thread_id)
+		thread_id = syscall(SYS_gettid);
+	ev.tid = thread_id;
+}
+
+void eMainloopProfile::begin()
+{
+	if (depth < MAX_DEPTH)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &frames[depth].start);
+		frames[depth].python = 0;
+	}
+	++depth;
+}
+
+void eMainloopProfile::end(int kind, const void *creator, PSignal &signal, int fd)
+{
+	if (--depth >= MAX_DEPTH)
+		return;
+	frame &f = frames[depth];
+	long long duration = usecSince(f.start);
+	if (depth)
+		frames[depth - 1].python += f.python;
+
+	std::string name = kind_name[kind];
+	if (kind == Notifier)
+	{
+		char buf[16];
+		snprintf(buf, sizeof(buf), " fd %d", fd);
+		name += buf;
+	}
+	name += ' ';
+	ePyObject list = signal.getSteal();
+	if (list && PyList_Size(list))
+	{
+		std::string callables;
+		for (int i = 0; i < PyList_Size(list); ++i)
+			appendPythonName(callables, PyList_GET_ITEM(list, i));
+		name += callables;
+	}
+	else
+	{
+		singleLock s(profile_lock);
+		name += creatorName(creator);
+	}
+	record(name, kind, f.start, duration, f.python);
+}
+
+void eMainloopProfile::poll(const timespec &start)
+{
+	record(kind_name[Poll], Poll, start, usecSince(start), 0);
+}
+
+void eMainloopProfile::addPython(const timespec &start)
+{
+	if (depth > 0 && depth <= MAX_DEPTH)
+		frames[depth - 1].python += usecSince(start);
+}
+
+void eMainloopProfile::setEnabled(bool enable)
+{
+	enabled = enable;
+	eDebug("[eMainloopProfile] profiling %s", enable ? "enabled" : "disabled");
+}
+
+void eMainloopProfile::reset()
+{
+	singleLock s(profile_lock);
+	stats.clear();
+	stat_index.clear();
+	creator_names.clear();
+	std::vector<traceEvent>().swap(trace);
+	trace_count = 0;
+}
+
+static void putValue(ePyObject dict, const char *key, ePyObject value)
+{
+	PyDict_SetItemString(dict, key, value);
+	Py_DECREF(value);
+}
+
+PyObject *eMainloopProfile::getStatistics()
+{
+	singleLock s(profile_lock);
+	ePyObject result = PyDict_New();
+	for (std::vector<callbackStat>::const_iterator it(stats.begin()); it != stats.end(); ++it)
+	{
+		ePyObject dict = PyDict_New();
+		putValue(dict, "kind", PyString_FromString(kind_name[it->kind]));
+		putValue(dict, "calls", PyLong_FromUnsignedLong(it->calls));
+		putValue(dict, "total_us", PyLong_FromLongLong(it->total));
+		putValue(dict, "python_us", PyLong_FromLongLong(it->python));
+		putValue(dict, "max_us", PyLong_FromLongLong(it->max));
+		ePyObject histogram = PyList_New(BUCKETS);
+		for (int i = 0; i < BUCKETS; ++i)
+			PyList_SET_ITEM(histogram, i, PyLong_FromUnsignedLong(it->histogram[i]));
+		putValue(dict, "histogram", histogram);
+		putValue(result, it->name.c_str(), dict);
+	}
+	return result;
+}
+
+static bool moreTime(const callbackStat *a, const callbackStat *b)
+{
+	return a->total > b->total;
+}
+
+void eMainloopProfile::dumpStatistics()
+{
+	singleLock s(profile_lock);
+	std::vector<const callbackStat*> sorted;
+	for (std::vector<callbackStat>::const_iterator it(stats.begin()); it != stats.end(); ++it)
+		sorted.push_back(&*it);
+	std::sort(sorted.begin(), sorted.end(), moreTime);
+	eDebug("[eMainloopProfile] %d callbacks, calls / total ms / python ms / max ms / name:", (int)sorted.size());
+	for (size_t i = 0; i < sorted.size() && i < 50; ++i)
+		eDebug("[eMainloopProfile] %7u %9lld %9lld %7lld %s", sorted[i]->calls, sorted[i]->total / 1000,
+			sorted[i]->python / 1000, sorted[i]->max / 1000, sorted[i]->name.c_str());
+}
+
+static void writeString(FILE *f, const std::string &s)
+{
+	fputc('"', f);
+	for (size_t i = 0; i < s.size(); ++i)
+	{
+		unsigned char c = s[i];
+		if (c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(f, "\\u%04x", c);
+		else
+			fputc(c, f);
+	}
+	fputc('"', f);
+}
+
+bool eMainloopProfile::writeTrace(const char *filename)
+{
+	FILE *f = fopen(filename, "w");
+	if (!f)
+	{
+		eDebug("[eMainloopProfile] couldn't write %s (%m)", filename);
+		return false;
+	}
+	singleLock s(profile_lock);
+	unsigned int count = trace_count < TRACE_EVENTS ? trace_count : TRACE_EVENTS;
+	int pid = getpid();
+	fprintf(f, "{\"traceEvents\":[\n");
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		const traceEvent &ev = trace[(trace_count - count + i) % TRACE_EVENTS];
+		const callbackStat &st = stats[ev.stat];
+		fprintf(f, "%s{\"name\":", i ? ",\n" : "");
+		writeString(f, st.name);
+		fprintf(f, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%d,\"tid\":%d,\"args\":{\"python_us\":%lld}}",
+			kind_name[st.kind], ev.start, ev.duration, pid, ev.tid, ev.python);
+	}
+	fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	bool ok = !ferror(f);
+	ok = !fclose(f) && ok;
+	eDebug("[eMainloopProfile] %u trace events written to %s", count, filename);
+	return ok;
+}
+
+void eMainloopProfile::checkDump()
+{
+	if (!dump_requested)
+		return;
+	dump_requested = 0;
+	dumpStatistics();
+	writeTrace("/tmp/enigma2_trace.json");
+}
+
+static void sigusr2_handler(int)
+{
+	if (eMainloopProfile::enabled)
+		dump_requested = 1;
+	else
+		eMainloopProfile::enabled = 1;
+}
+
+void eMainloopProfile::installSignalHandler()
+{
+	struct sigaction act;
+
+	act.sa_handler = sigusr2_handler;
+	act.sa_flags = SA_RESTART;
+
+	if (sigemptyset(&act.sa_mask) == -1)
+		perror("sigemptyset");
+	if (sigaction(SIGUSR2, &act, 0) == -1)
+		perror("SIGUSR2");
+}
@@ -0,0 +1,60 @@
+#ifndef __lib_base_loopprofile_h
+#define __lib_base_loopprofile_h
+
+#ifndef SWIG
+#include <time.h>
+#endif
+#include <lib/python/python.h>
+
+class PSignal;
+
+/**
+ * \brief Optional profiling of the mainloop callbacks.
+ *
+ * When enabled, every eTimer and eSocketNotifier callback run by a
+ * mainloop is timed. The times are collected per callback: the python
+ * callables connected to the signal, or for native callbacks the
+ * function which created the timer or socket notifier. For each of them
+ * the calls, the total, python and maximum time and a histogram of the
+ * call times are kept, the time spent waiting in poll is kept as "poll".
+ * The last TRACE_EVENTS calls are also kept to be written as a chrome
+ * trace (chrome://tracing, perfetto).
+ *
+ * When disabled the mainloop only tests \c enabled once per event.
+ *
+ * The first SIGUSR2 enables the profiling, every following one writes
+ * the statistics to the log and the trace to /tmp/enigma2_trace.json.
+ */
+class eMainloopProfile
+{
+#ifndef SWIG
+public:
+	enum { Timer, Notifier, Poll };
+	enum { BUCKETS = 12, TRACE_EVENTS = 16384 };
+
+	static volatile int enabled;
+
+		/* called by the mainloop around the callbacks */
+	static void begin();
+	static void end(int kind, const void *creator, PSignal &signal, int fd=-1);
+	static void poll(const timespec &start);
+		/* called by PSignal::callPython with the time of the python call */
+	static void addPython(const timespec &start);
+		/* writes the statistics and the trace when requested by SIGUSR2 */
+	static void checkDump();
+	static void installSignalHandler();
+#endif
+public:
+	static void setEnabled(bool enable);
+	static bool isEnabled() { return enabled; }
+	static void reset();
+		/* returns { name: { "kind", "calls", "total_us", "python_us",
+		   "max_us", "histogram" } }, "histogram" counts the calls shorter
+		   than 50us, 100us, 200us, 500us, 1ms, 2ms, 5ms, 10ms, 20ms, 50ms,
+		   100ms and longer */
+	static PyObject *getStatistics();
+	static void dumpStatistics();
+	static bool writeTrace(const char *filename);
+};
+
+#endif
@@ -5,6 +5,8 @@
 #include <lib/python/connections.h>
 #include <lib/python/swig.h>
 #include <unistd.h>
+#include <sys/eventfd.h>
+#include <deque>
 #include <lib/base/elock.h>
 
 
@@ -33,32 +35,177 @@ protected:
 /**
  * \brief A messagepump with fixed-length packets.
  *
- * Based on \ref eMessagePump, with this class you can send and receive fixed size messages.
- * Automatically creates a eSocketNotifier and gives you a callback.
+ * With this class you can send fixed size messages from any thread and
+ * receive them in the thread of \c context. Automatically creates a
+ * eSocketNotifier and gives you a callback.
+ *
+ * The messages are passed in a bounded lock free ring (any number of
+ * senders, one receiver). The receiver is woken by an eventfd, which is
+ * only written by the first message sent after the receiver emptied the
+ * ring, so a burst of messages costs one write and one read. The ring
+ * holds 4kB of messages, when it is full the messages are queued in a
+ * locked list until the receiver caught up. Like on a full pipe the
+ * sender waits when 64kB of messages are pending. \c mt is only kept for
+ * compatibility, the ring is safe for all senders.
  */
 template<class T>
-class eFixedMessagePump: private eMessagePump, public Object
+class eFixedMessagePump: public Object
 {
+	struct cell
+	{
+		volatile unsigned int sequence;
+		T msg;
+	};
+	cell *m_ring;
+	unsigned int m_mask;
+	volatile unsigned int m_head; // next cell claimed by a sender
+	unsigned int m_tail; // next cell read by the receiver
+	volatile int m_woken; // the eventfd was written and not read yet
+	// the messages sent while the ring was full, m_overflowed is set while
+	// the list is not empty so the senders keep the order behind it
+	std::deque<T> m_overflow;
+	eSingleLock m_overflow_lock;
+	unsigned int m_overflow_max;
+	volatile int m_overflowed;
+	bool *m_destroyed; // of the innermost do_recv, set by the destructor
+	int m_fd;
 	ePtr<eSocketNotifier> sn;
+
+	void wakeup()
+	{
+		if (__sync_bool_compare_and_swap(&m_woken, 0, 1))
+		{
+			eventfd_t one = 1;
+			::write(m_fd, &one, sizeof(one));
+		}
+	}
+	bool push(const T &msg)
+	{
+		unsigned int pos = m_head;
+		cell *s;
+		while (1)
+		{
+			s = &m_ring[pos & m_mask];
+			int diff = (int)(s->sequence - pos);
+			if (!diff)
+			{
+				if (__sync_bool_compare_and_swap(&m_head, pos, pos + 1))
+					break;
+			}
+			else if (diff < 0) // full
+				return false;
+			pos = m_head;
+		}
+		s->msg = msg;
+		__sync_synchronize();
+		s->sequence = pos + 1;
+		return true;
+	}
+	bool pop(T &msg)
+	{
+		cell &s = m_ring[m_tail & m_mask];
+		if ((int)(s.sequence - (m_tail + 1)) < 0) // empty or not completely sent yet
+		{
+			// the list is behind all messages in the ring
+			if (!m_overflowed || m_head != m_tail)
+				return false;
+			eSingleLocker l(m_overflow_lock);
+			if (m_overflow.empty())
+				return false;
+			msg = m_overflow.front();
+			m_overflow.pop_front();
+			if (m_overflow.empty())
+				m_overflowed = 0;
+			return true;
+		}
+		__sync_synchronize();
+		msg = s.msg;
+		__sync_synchronize();
+		s.sequence = m_tail + m_mask + 1;
+		++m_tail;
+		return true;
+	}
 	void do_recv(int)
 	{
+		eventfd_t cnt;
+		::read(m_fd, &cnt, sizeof(cnt));
+		m_woken = 0;
+		__sync_synchronize();
+		// a callback can run a nested loop which calls do_recv again,
+		// the destroyed flags are chained through the stack
+		bool destroyed = false;
+		bool *outer = m_destroyed;
+		m_destroyed = &destroyed;
 		T msg;
-		recv(&msg, sizeof(msg));
-		/*emit*/ recv_msg(msg);
+		while (pop(msg))
+		{
+			/*emit*/ recv_msg(msg);
+			if (destroyed)
+			{
+				if (outer)
+					*outer = true;
+				return;
+			}
+			if (!sn->isRunning()) // stopped by the callback, start() wakes us again
+				break;
+		}
+		m_destroyed = outer;
 	}
 public:
 	Signal1<void,const T&> recv_msg;
 	void send(const T &msg)
 	{
-		eMessagePump::send(&msg, sizeof(msg));
+		while (m_overflowed || !push(msg))
+		{
+			{
+				eSingleLocker l(m_overflow_lock);
+				if (m_overflow.size() < m_overflow_max)
+				{
+					m_overflow.push_back(msg);
+					m_overflowed = 1;
+					break;
+				}
+			}
+			wakeup(); // full, wait for the receiver
+			usleep(1000);
+		}
+		__sync_synchronize();
+		wakeup();
 	}
-	eFixedMessagePump(eMainloop *context, int mt): eMessagePump(mt)
+	eFixedMessagePump(eMainloop *context, int mt)
+		:m_head(0), m_tail(0), m_woken(0), m_overflowed(0), m_destroyed(0)
 	{
-		sn=eSocketNotifier::create(context, getOutputFD(), eSocketNotifier::Read);
+		unsigned int size = 8;
+		while (size * 2 * sizeof(cell) <= 4096)
+			size *= 2;
+		m_overflow_max = 65536 / sizeof(T);
+		m_ring = new cell[size];
+		m_mask = size - 1;
+		for (unsigned int i = 0; i < size; ++i)
+			m_ring[i].sequence = i;
+		m_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		sn=eSocketNotifier::create(context, m_fd, eSocketNotifier::Read);
 		CONNECT(sn->activated, eFixedMessagePump<T>::do_recv);
 		sn->start();
 	}
-	void start() { if (sn) sn->start(); }
+	~eFixedMessagePump()
+	{
+		if (m_destroyed)
+			*m_destroyed = true;
+		sn = 0;
+		::close(m_fd);
+		delete [] m_ring;
+	}
+	void start()
+	{
+		if (sn)
+		{
+			sn->start();
+			m_woken = 0;
+			__sync_synchronize();
+			wakeup(); // for the messages left by stop()
+		}
+	}
 	void stop() { if (sn) sn->stop(); }
 };
 #endif
@@ -73,124 +73,37 @@ public:
 				if (!ref) \
 					delete this; \
 			}
-	#elif defined(__mips__)
-		#define DECLARE_REF(x) 			\
-			public: void AddRef(); 		\
-					void Release();		\
-			private: oRefCount ref; 
-		#define DEFINE_REF(c) \
-			void c::AddRef() \
-			{ \
-				unsigned long temp; \
-				__asm__ __volatile__( \
-				"		.set	mips3											\n" \
-				"1:		ll		%0, %1	# load counter							\n" \
-				"		.set	mips0											\n" \
-				"		addu	%0, 1	# increment								\n" \
-				"		.set	mips3											\n" \
-				"		sc		%0, %1	# try to store, checking for atomicity	\n" \
-				"		.set	mips0											\n" \
-				"		beqz	%0, 1b	# if not atomic (0), try again			\n" \
-				: "=&r" (temp), "=m" (ref.count) \
-				: "m" (ref.count) \
-				: ); \
-			} \
-			void c::Release() \
-			{ \
-				unsigned long temp; \
-				__asm__ __volatile__( \
-				"		.set	mips3				\n" \
-				"1:		ll		%0, %1				\n" \
-				"		.set	mips0				\n" \
-				"		subu	%0, 1	# decrement	\n" \
-				"		.set	mips3				\n" \
-				"		sc		%0, %1				\n" \
-				"		.set	mips0				\n" \
-				"		beqz	%0, 1b				\n" \
-				: "=&r" (temp), "=m" (ref.count) \
-				: "m" (ref.count) \
-				: ); \
-				if (!ref) \
-					delete this; \
-			}
-	#elif defined(__ppc__) || defined(__powerpc__)
+	#else
 		#define DECLARE_REF(x) 			\
 			public: void AddRef(); 		\
 					void Release();		\
 			private: oRefCount ref;
+		/* taking a reference needs no ordering. the release has to order
+		   the writes of this owner before the delete by the last owner,
+		   and the last owner has to see them (acq_rel). */
+		#if defined(__ATOMIC_ACQ_REL)
 		#define DEFINE_REF(c) \
 			void c::AddRef() \
 			{ \
-				int temp; \
-				__asm__ __volatile__( \
-				"1:		lwarx	%0, 0, %3	\n" \
-				"		add		%0, %2, %0	\n" \
-				"		dcbt	0, %3		# workaround for PPC405CR Errata\n" \
-				"		stwcx.	%0, 0, %3	\n" \
-				"		bne-	1b			\n" \
-				: "=&r" (temp), "=m" (ref.count) \
-				: "r" (1), "r" (&ref.count), "m" (ref.count) \
-				: "cc"); \
+				__atomic_add_fetch(&ref.count, 1, __ATOMIC_RELAXED); \
 			} \
 			void c::Release() \
 			{ \
-				int temp; \
-				__asm__ __volatile__( \
-				"1:		lwarx	%0, 0, %3	\n" \
-				"		subf	%0, %2, %0	\n" \
-				"		dcbt	0, %3		# workaround for PPC405CR Errata\n" \
-				"		stwcx.	%0, 0, %3	\n" \
-				"		bne-	1b			\n" \
-				: "=&r" (temp), "=m" (ref.count) \
-				: "r" (1), "r" (&ref.count), "m" (ref.count) \
-				: "cc"); \
-				if (!ref) \
+				if (!__atomic_sub_fetch(&ref.count, 1, __ATOMIC_ACQ_REL)) \
 					delete this; \
 			}
-	#elif defined(__i386__) || defined(__x86_64__)
-		#define DECLARE_REF(x) 			\
-			public: void AddRef(); 		\
-					void Release();		\
-			private: oRefCount ref;
+		#else
 		#define DEFINE_REF(c) \
 			void c::AddRef() \
 			{ \
-				__asm__ __volatile__( \
-				"		lock ; incl	%0	\n" \
-				: "=m" (ref.count) \
-				: "m" (ref.count)); \
+				__sync_add_and_fetch(&ref.count, 1); \
 			} \
 			void c::Release() \
 			{ \
-				__asm__ __volatile__( \
-				"		lock ; decl	%0	\n" \
-				: "=m" (ref.count) \
-				: "m" (ref.count)); \
-				if (!ref) \
-					delete this; \
-			}
-	#else
-		#warning use non optimized implementation of refcounting.
-		#define DECLARE_REF(x) 			\
-			public: void AddRef(); 		\
-					void Release();		\
-			private:oRefCount ref; 	\
-					eSingleLock ref_lock;
-		#define DEFINE_REF(c) \
-			void c::AddRef() \
-			{ \
-				eSingleLocker l(ref_lock); \
-				++ref; \
-			} \
-			void c::Release() \
-	 		{ \
-				{ \
-					eSingleLocker l(ref_lock); \
-					--ref; \
-				} \
-				if (!ref) \
+				if (!__sync_sub_and_fetch(&ref.count, 1)) \
 					delete this; \
 			}
+		#endif
 	#endif
 #else  // SWIG
 	#define DECLARE_REF(x) \
@@ -0,0 +1,91 @@
+#include <lib/base/slaballoc.h>
+#include <lib/base/eerror.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+eSlabAllocator::eSlabAllocator(size_t blocksize)
+	:m_blocksize(blocksize), m_current(0), m_current_left(0), m_inuse(0), m_chunks(0)
+{
+	memset(m_free, 0, sizeof(m_free));
+}
+
+eSlabAllocator::~eSlabAllocator()
+{
+	if (m_chunks)
+		eDebug("[eSlabAllocator] destroyed with %zu chunks (%zu bytes) still in use", m_chunks, m_inuse);
+	for (std::vector<char*>::iterator it(m_blocks.begin()); it != m_blocks.end(); ++it)
+		::operator delete(*it);
+}
+
+void *eSlabAllocator::alloc(size_t size)
+{
+	size_t chunk = chunkSize(size);
+		/* like new, never returns 0: out of memory throws std::bad_alloc */
+	if (chunk > SLAB_MAX_CHUNK)
+		return ::operator new(size);
+
+	void *ret;
+	freeChunk *&head = m_free[chunk / SLAB_ALIGN];
+	if (head)
+	{
+		ret = head;
+		head = head->next;
+	}
+	else
+	{
+		if (m_current_left < chunk)
+		{
+			/* put the rest of the current block to the matching free list */
+			while (m_current_left >= SLAB_ALIGN)
+			{
+				size_t rest = m_current_left > SLAB_MAX_CHUNK ? SLAB_MAX_CHUNK : m_current_left;
+				freeChunk *c = (freeChunk*)m_current;
+				c->next = m_free[rest / SLAB_ALIGN];
+				m_free[rest / SLAB_ALIGN] = c;
+				m_current += rest;
+				m_current_left -= rest;
+			}
+			m_current = 0;
+			m_current_left = 0;
+			m_current = (char*)::operator new(m_blocksize);
+			m_blocks.push_back(m_current);
+			m_current_left = m_blocksize;
+		}
+		ret = m_current;
+		m_current += chunk;
+		m_current_left -= chunk;
+	}
+	m_inuse += chunk;
+	++m_chunks;
+	return ret;
+}
+
+void eSlabAllocator::free(void *p, size_t size)
+{
+	if (!p)
+		return;
+	size_t chunk = chunkSize(size);
+	if (chunk > SLAB_MAX_CHUNK)
+	{
+		::operator delete(p);
+		return;
+	}
+	freeChunk *c = (freeChunk*)p;
+	c->next = m_free[chunk / SLAB_ALIGN];
+	m_free[chunk / SLAB_ALIGN] = c;
+	m_inuse -= chunk;
+	--m_chunks;
+}
+
+void eSlabAllocator::reset()
+{
+	ASSERT(!m_chunks);
+	for (std::vector<char*>::iterator it(m_blocks.begin()); it != m_blocks.end(); ++it)
+		::operator delete(*it);
+	m_blocks.clear();
+	memset(m_free, 0, sizeof(m_free));
+	m_current = 0;
+	m_current_left = 0;
+	m_inuse = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef __lib_base_slaballoc_h
+#define __lib_base_slaballoc_h
+
+#include <stddef.h>
+#include <vector>
+
+/**
+ * \brief An arena allocator for lots of small objects.
+ *
+ * Memory is taken from the heap in big blocks and carved into chunks of
+ * size classes with a granularity of \c SLAB_ALIGN bytes. Freed chunks go
+ * to a per class free list and are reused by the next allocation of the
+ * same class, so there is neither malloc header overhead nor heap
+ * fragmentation for the stored objects.
+ *
+ * The allocator is not thread safe, callers must serialize access.
+ */
+class eSlabAllocator
+{
+public:
+	enum { SLAB_ALIGN = sizeof(void*), SLAB_MAX_CHUNK = 256 };
+
+	eSlabAllocator(size_t blocksize=32*1024);
+	~eSlabAllocator();
+
+		/* never returns 0, throws std::bad_alloc like new */
+	void *alloc(size_t size);
+	void free(void *p, size_t size);
+
+		/* releases all blocks. only allowed when no chunk is in use anymore */
+	void reset();
+
+	size_t bytesAllocated() const { return m_blocks.size() * m_blocksize; }
+	size_t bytesInUse() const { return m_inuse; }
+	size_t chunksInUse() const { return m_chunks; }
+private:
+	enum { SLAB_CLASSES = SLAB_MAX_CHUNK / SLAB_ALIGN };
+	struct freeChunk
+	{
+		freeChunk *next;
+	};
+	size_t m_blocksize;
+	std::vector<char*> m_blocks;
+	char *m_current;
+	size_t m_current_left;
+	size_t m_inuse, m_chunks;
+	freeChunk *m_free[SLAB_CLASSES + 1];
+
+	static size_t chunkSize(size_t size)
+	{
+		return size ? (size + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1) : SLAB_ALIGN;
+	}
+	eSlabAllocator(const eSlabAllocator &);
+	eSlabAllocator &operator=(const eSlabAllocator &);
+};
+
+#endif
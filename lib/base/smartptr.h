@@ -34,13 +34,11 @@ public:
 	{
 		if (c)
 			c->AddRef();
-		updatePtrStr();
 	}
 	ePtr(const ePtr &c): ptr(c.ptr)
 	{
 		if (ptr)
 			ptr->AddRef();
-		updatePtrStr();
 	}
 	ePtr &operator=(T *c)
 	{
@@ -49,7 +47,6 @@ public:
 		if (ptr)
 			ptr->Release();
 		ptr=c;
-		updatePtrStr();
 		return *this;
 	}
 	ePtr &operator=(ePtr<T> &c)
@@ -59,16 +56,35 @@ public:
 		if (ptr)
 			ptr->Release();
 		ptr=c.ptr;
-		updatePtrStr();
 		return *this;
 	}
+#if __cplusplus >= 201103L && !defined(SWIG)
+		/* a moved reference is not counted again */
+	ePtr(ePtr &&c): ptr(c.ptr)
+	{
+		c.ptr = 0;
+	}
+	ePtr &operator=(ePtr &&c)
+	{
+		if (this != &c)
+		{
+			if (ptr)
+				ptr->Release();
+			ptr = c.ptr;
+			c.ptr = 0;
+		}
+		return *this;
+	}
+#endif
 	~ePtr()
 	{
 		if (ptr)
 			ptr->Release();
 	}
+		/* only formatted when asked for, not on every copy */
 	char *getPtrString()
 	{
+		updatePtrStr();
 		return m_ptrStr;
 	}
 #ifndef SWIG
@@ -138,6 +154,26 @@ public:
 		ptr=c.ptr;
 		return *this;
 	}
+#if __cplusplus >= 201103L && !defined(SWIG)
+	eUsePtr(eUsePtr &&c): ptr(c.ptr)
+	{
+		c.ptr = 0;
+	}
+	eUsePtr &operator=(eUsePtr &&c)
+	{
+		if (this != &c)
+		{
+			if (ptr)
+			{
+				ptr->ReleaseUse();
+				ptr->Release();
+			}
+			ptr = c.ptr;
+			c.ptr = 0;
+		}
+		return *this;
+	}
+#endif
 	~eUsePtr()
 	{
 		if (ptr)
@@ -0,0 +1,221 @@
+#include <lib/base/threadpool.h>
+#include <lib/base/message.h>
+#include <lib/base/eerror.h>
+#include <lib/base/elock.h>
+
+#include <unistd.h>
+#include <sched.h>
+
+static eThreadPool *instance;
+static pthread_once_t instance_once = PTHREAD_ONCE_INIT;
+
+	/* the index + 1 of the worker running in this thread */
+static __thread int current_worker;
+
+eThreadPool::job::job()
+	:m_state(stateQueued), m_priority(prioNormal), m_ioprio_class(IOPRIO_CLASS_NONE),
+	m_ioprio(7), m_worker(0), m_cancelled(false), m_pump(0)
+{
+}
+
+eThreadPool::job::~job()
+{
+}
+
+eThreadPool::worker::worker(eThreadPool *pool, int index)
+	:m_pool(pool), m_index(index), m_ioprio_class(IOPRIO_CLASS_NONE), m_ioprio(0)
+{
+	pthread_mutex_init(&m_lock, 0);
+}
+
+void eThreadPool::worker::thread()
+{
+	hasStarted();
+	current_worker = m_index + 1;
+	nice(4);
+	m_pool->work(this);
+}
+
+void eThreadPool::create()
+{
+	instance = new eThreadPool();
+}
+
+eThreadPool *eThreadPool::getInstance()
+{
+	pthread_once(&instance_once, create);
+	return instance;
+}
+
+eThreadPool::eThreadPool()
+	:m_next(0), m_pending(0), m_waiting(0)
+{
+	pthread_mutex_init(&m_lock, 0);
+	pthread_cond_init(&m_wakeup, 0);
+	pthread_cond_init(&m_done, 0);
+
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	m_workers = cpus < 2 ? 2 : cpus > 4 ? 4 : cpus;
+	m_worker = new worker*[m_workers];
+	for (int i = 0; i < m_workers; ++i)
+		m_worker[i] = new worker(this, i);
+	for (int i = 0; i < m_workers; ++i)
+		m_worker[i]->runAsync();
+	eDebug("[eThreadPool] started %d workers", m_workers);
+}
+
+void eThreadPool::queue(job *j, int priority, eMainloop *context, int ioprio_class, int ioprio)
+{
+	if (priority < prioHigh || priority >= PRIORITIES)
+		priority = prioNormal;
+	j->m_state = job::stateQueued;
+	j->m_priority = priority;
+	j->m_ioprio_class = ioprio_class;
+	j->m_ioprio = ioprio;
+	j->m_cancelled = false;
+	j->m_pump = 0;
+	if (context)
+	{
+		singleLock s(m_lock);
+		eFixedMessagePump<job*> *&pump = m_pumps[context];
+		if (!pump)
+		{
+				/* created in the thread of the context, its socket notifier belongs to it */
+			pump = new eFixedMessagePump<job*>(context, 1);
+			CONNECT(pump->recv_msg, eThreadPool::delivered);
+		}
+		j->m_pump = pump;
+	}
+
+	worker *w;
+	if (current_worker)
+		w = m_worker[current_worker - 1];
+	else
+		w = m_worker[__sync_fetch_and_add(&m_next, 1) % m_workers];
+	j->m_worker = w->m_index;
+	{
+		singleLock s(w->m_lock);
+		w->m_queue[priority].push_back(j);
+	}
+	singleLock s(m_lock);
+	++m_pending;
+	pthread_cond_signal(&m_wakeup);
+}
+
+void eThreadPool::cancel(job *j)
+{
+	ASSERT(j->m_pump);
+	{
+		singleLock s(m_worker[j->m_worker]->m_lock);
+		j->m_cancelled = true;
+		if (j->m_state == job::stateQueued)
+			return;
+	}
+	singleLock s(m_lock);
+	++m_waiting;
+	while (j->m_state == job::stateRunning)
+		pthread_cond_wait(&m_done, &m_lock);
+	--m_waiting;
+}
+
+	/* the highest priority job, first from the own queues, else the
+	   oldest one of the others */
+eThreadPool::job *eThreadPool::take(worker *w)
+{
+	for (int prio = prioHigh; prio < PRIORITIES; ++prio)
+	{
+		for (int i = 0; i < m_workers; ++i)
+		{
+			worker *victim = m_worker[(w->m_index + i) % m_workers];
+			singleLock s(victim->m_lock);
+			std::deque<job*> &q = victim->m_queue[prio];
+			if (q.empty())
+				continue;
+			job *j = q.front();
+			q.pop_front();
+			j->m_state = job::stateRunning;
+			return j;
+		}
+	}
+	return 0;
+}
+
+void eThreadPool::runJob(worker *w, job *j)
+{
+		/* cancel sets m_cancelled under the lock of the worker the job was
+		   queued to, also while the job is running, and then waits until
+		   it is done. So run() is skipped when the job was cancelled
+		   before this point, else only finished() is skipped */
+	bool cancelled;
+	{
+		singleLock s(m_worker[j->m_worker]->m_lock);
+		cancelled = j->m_cancelled;
+	}
+	int ioprio_class = j->m_ioprio_class, ioprio = j->m_ioprio;
+	if (ioprio_class == IOPRIO_CLASS_NONE)
+		ioprio = 0;
+	if (!cancelled && (ioprio_class != w->m_ioprio_class || ioprio != w->m_ioprio))
+	{
+		setIoPrio(ioprio_class, ioprio);
+		w->m_ioprio_class = ioprio_class;
+		w->m_ioprio = ioprio;
+	}
+
+	if (!cancelled)
+		j->run();
+
+	eFixedMessagePump<job*> *pump = j->m_pump;
+	if (!pump)
+	{
+		delete j;
+		return;
+	}
+	{
+		singleLock s(m_lock);
+		j->m_state = job::stateDone;
+		if (m_waiting)
+			pthread_cond_broadcast(&m_done);
+	}
+		/* from here on the job belongs to the context */
+	pump->send(j);
+}
+
+void eThreadPool::work(worker *w)
+{
+	while (1)
+	{
+		{
+			singleLock s(m_lock);
+			while (!m_pending)
+				pthread_cond_wait(&m_wakeup, &m_lock);
+			--m_pending;
+		}
+			/* a job is reserved for us. Another worker may take it,
+			   then its own one is left, so just look again */
+		job *j;
+		while (!(j = take(w)))
+			sched_yield();
+		runJob(w, j);
+		if (w->m_ioprio_class != IOPRIO_CLASS_NONE)
+		{
+			bool idle;
+			{
+				singleLock s(m_lock);
+				idle = !m_pending;
+			}
+			if (idle)
+			{
+				setIoPrio(IOPRIO_CLASS_NONE, 0);
+				w->m_ioprio_class = IOPRIO_CLASS_NONE;
+				w->m_ioprio = 0;
+			}
+		}
+	}
+}
+
+void eThreadPool::delivered(job * const &j)
+{
+	if (!j->m_cancelled)
+		j->finished();
+	delete j;
+}
@@ -0,0 +1,96 @@
+#ifndef __lib_base_threadpool_h
+#define __lib_base_threadpool_h
+
+#include <pthread.h>
+#include <deque>
+#include <map>
+#include <lib/base/thread.h>
+#include <lib/base/ebase.h>
+#include <lib/base/ioprio.h>
+
+template<class T> class eFixedMessagePump;
+
+/**
+ * \brief A shared pool of worker threads for short background jobs.
+ *
+ * Instead of a thread per object (and per request), jobs are queued to
+ * a few workers, one per cpu (at least 2, at most 4), which run them at
+ * nice 4. Each worker has its own queue per priority. Jobs queued from
+ * the mainloop are spread over the workers, jobs queued by a job go to
+ * the queue of its worker. A worker runs the jobs of its own queue
+ * first and when it has nothing left takes the oldest jobs of the
+ * others, so a long job doesn't delay the jobs queued behind it. Higher
+ * priorities always run first.
+ *
+ * A job may be run with an io priority, the worker sets it with
+ * setIoPrio before the job and resets it afterwards.
+ *
+ * When a job is queued with a context, its finished() is called from
+ * that mainloop after run() returned, and the job is deleted after it.
+ * Such jobs have to be queued from the thread of the context, and the
+ * context must not be destroyed as long as it has jobs. Jobs without a
+ * context are deleted by the worker after run().
+ */
+class eThreadPool: public Object
+{
+public:
+	enum { prioHigh, prioNormal, prioLow, PRIORITIES };
+
+	class job
+	{
+		friend class eThreadPool;
+		enum { stateQueued, stateRunning, stateDone };
+		int m_state, m_priority, m_ioprio_class, m_ioprio, m_worker;
+		bool m_cancelled;
+		eFixedMessagePump<job*> *m_pump;
+	public:
+		job();
+		virtual ~job();
+			/* called in a worker thread */
+		virtual void run()=0;
+			/* called in the thread of the context after run(),
+			   unless the job was cancelled */
+		virtual void finished() {}
+	};
+
+	static eThreadPool *getInstance();
+
+		/* takes the ownership of j */
+	void queue(job *j, int priority=prioNormal, eMainloop *context=0,
+		int ioprio_class=IOPRIO_CLASS_NONE, int ioprio=7);
+		/* only for jobs with a context, from the thread of the context.
+		   A queued job won't run, a running job is waited for. In both
+		   cases finished() isn't called anymore, the job is deleted
+		   later by the context. */
+	void cancel(job *j);
+private:
+	class worker: public eThread
+	{
+		eThreadPool *m_pool;
+		void thread();
+	public:
+		int m_index;
+		pthread_mutex_t m_lock;
+		std::deque<job*> m_queue[PRIORITIES];
+		int m_ioprio_class, m_ioprio;
+		worker(eThreadPool *pool, int index);
+	};
+	friend class worker;
+
+	int m_workers;
+	worker **m_worker;
+	unsigned int m_next; // round robin for the jobs queued from outside
+	pthread_mutex_t m_lock;
+	pthread_cond_t m_wakeup, m_done;
+	int m_pending, m_waiting;
+	std::map<eMainloop*, eFixedMessagePump<job*>*> m_pumps;
+
+	eThreadPool();
+	static void create();
+	void work(worker *w);
+	job *take(worker *w);
+	void runJob(worker *w, job *j);
+	void delivered(job * const &j);
+};
+
+#endif
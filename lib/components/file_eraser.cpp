@@ -1,50 +1,50 @@
 #include <lib/components/file_eraser.h>
-#include <lib/base/ioprio.h>
 #include <lib/base/eerror.h>
+#include <lib/base/elock.h>
 #include <lib/base/init.h>
 #include <lib/base/init_num.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 
 eBackgroundFileEraser *eBackgroundFileEraser::instance;
 
+class eFileEraseJob: public eThreadPool::job
+{
+	eBackgroundFileEraser *m_eraser;
+public:
+	eFileEraseJob(eBackgroundFileEraser *eraser)
+		:m_eraser(eraser)
+	{
+	}
+	void run()
+	{
+		std::string filename;
+		while (m_eraser->next(filename))
+		{
+			if ( ::unlink(filename.c_str()) < 0 )
+				eDebug("remove file %s failed (%m)", filename.c_str());
+			else
+				eDebug("file %s erased", filename.c_str());
+		}
+	}
+};
+
 eBackgroundFileEraser::eBackgroundFileEraser()
-	:messages(this,1), stop_thread_timer(eTimer::create(this))
+	:m_running(false)
 {
+	pthread_mutex_init(&m_lock, 0);
 	if (!instance)
 		instance=this;
-	CONNECT(messages.recv_msg, eBackgroundFileEraser::gotMessage);
-	CONNECT(stop_thread_timer->timeout, eBackgroundFileEraser::idle);
-}
-
-void eBackgroundFileEraser::idle()
-{
-	quit(0);
 }
 
 eBackgroundFileEraser::~eBackgroundFileEraser()
 {
-	messages.send(Message::quit);
 	if (instance==this)
 		instance=0;
-	kill();  // i dont understand why this is needed .. in ~eThread::eThread is a kill() to..
-}
-
-void eBackgroundFileEraser::thread()
-{
-	hasStarted();
-
-	nice(5);
-
-	setIoPrio(IOPRIO_CLASS_BE, 7);
-
-	reset();
-
-	runLoop();
-
-	stop_thread_timer->stop();
 }
 
 void eBackgroundFileEraser::erase(const char *filename)
@@ -57,33 +57,28 @@ void eBackgroundFileEraser::erase(const char *filename)
 			;/*perror("rename file failed !!!");*/
 		else
 		{
-			messages.send(Message(Message::erase, strdup(buf)));
-			run();
+			singleLock s(m_lock);
+			m_pending.push_back(buf);
+			if (m_running)
+				return;
+			m_running = true;
+			eThreadPool::getInstance()->queue(new eFileEraseJob(this), eThreadPool::prioLow, 0, IOPRIO_CLASS_BE, 7);
 		}
 	}
 }
 
-void eBackgroundFileEraser::gotMessage(const Message &msg )
+	/* called by the erase job, which ends when there is nothing left */
+bool eBackgroundFileEraser::next(std::string &filename)
 {
-	switch (msg.type)
+	singleLock s(m_lock);
+	if (m_pending.empty())
 	{
-		case Message::erase:
-			if ( msg.filename )
-			{
-				if ( ::unlink(msg.filename) < 0 )
-					eDebug("remove file %s failed (%m)", msg.filename);
-				else
-					eDebug("file %s erased", msg.filename);
-				free((char*)msg.filename);
-			}
-			stop_thread_timer->start(1000, true); // stop thread in one seconds
-			break;
-		case Message::quit:
-			quit(0);
-			break;
-		default:
-			eDebug("unhandled thread message");
+		m_running = false;
+		return false;
 	}
+	filename = m_pending.front();
+	m_pending.pop_front();
+	return true;
 }
 
 eAutoInitP0<eBackgroundFileEraser> init_eBackgroundFilEraser(eAutoInitNumbers::configuration+1, "Background File Eraser");
@@ -1,32 +1,23 @@
 #ifndef __lib_components_file_eraser_h
 #define __lib_components_file_eraser_h
 
-#include <lib/base/thread.h>
-#include <lib/base/message.h>
-#include <lib/base/ebase.h>
+#include <lib/base/threadpool.h>
+#ifndef SWIG
+#include <deque>
+#include <string>
+#endif
 
-class eBackgroundFileEraser: public eMainloop, private eThread, public Object
+class eBackgroundFileEraser
 {
-	struct Message
-	{
-		int type;
-		const char *filename;
-		enum
-		{
-			erase,
-			quit
-		};
-		Message(int type=0, const char *filename=0)
-			:type(type), filename(filename)
-		{}
-	};
-	eFixedMessagePump<Message> messages;
 	static eBackgroundFileEraser *instance;
-	void gotMessage(const Message &message);
-	void thread();
-	void idle();
-	ePtr<eTimer> stop_thread_timer;
 #ifndef SWIG
+	friend class eFileEraseJob;
+		/* the files are erased one after the other by a single job, so
+		   several big deletes don't compete for the disk */
+	pthread_mutex_t m_lock;
+	std::deque<std::string> m_pending;
+	bool m_running;
+	bool next(std::string &filename);
 public:
 #endif
 	eBackgroundFileEraser();
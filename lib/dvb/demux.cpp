@@ -30,6 +30,7 @@
 eDVBDemux::eDVBDemux(int adapter, int demux): adapter(adapter), demux(demux)
 {
 	m_dvr_busy = 0;
+	m_record_mux = 0;
 }
 
 eDVBDemux::~eDVBDemux()
@@ -52,6 +53,14 @@ int eDVBDemux::openDVR(int flags)
 
 DEFINE_REF(eDVBDemux)
 
+RESULT eDVBDemux::getRecordMux(ePtr<eDVBRecordMux> &mux)
+{
+	if (!m_record_mux)
+		m_record_mux = new eDVBRecordMux(this);
+	mux = m_record_mux;
+	return 0;
+}
+
 RESULT eDVBDemux::setSourceFrontend(int fenum)
 {
 	int fd = openDemux();
@@ -231,7 +240,7 @@ RESULT eDVBSectionReader::start(const eDVBSectionFilterMask &mask)
 	if (mask.flags & eDVBSectionFilterMask::rfCRC)
 	{
 		sct.flags |= DMX_CHECK_CRC;
-		checkcrc = 1;
+		checkcrc = !(mask.flags & eDVBSectionFilterMask::rfDeferCRC);
 	} else
 #endif
 		checkcrc = 0;
@@ -373,9 +382,28 @@ RESULT eDVBPESReader::connectRead(const Slot2<void,const __u8*,int> &r, ePtr<eCo
 }
 
 eDVBRecordFileThread::eDVBRecordFileThread()
-	:eFilePushThread(IOPRIO_CLASS_RT, 7), m_ts_parser(m_stream_info)
+	:eFilePushThread(IOPRIO_CLASS_RT, 7), m_ts_parser(m_stream_info), m_parser(*this)
 {
 	m_current_offset = 0;
+	enableSplice(true);
+	m_parse_data = new unsigned char[(PARSE_BLOCKS + 1) * BUFFER_SIZE];
+	memset(m_parse_refs, 0, sizeof(m_parse_refs));
+	m_parse_current = -1;
+	m_parse_write = m_parse_read = m_parse_queued = 0;
+	m_parse_gap = m_parse_stop = m_parser_running = false;
+	m_overflow_reported = m_lag_reported = false;
+	memset(&m_parse_stats, 0, sizeof(m_parse_stats));
+	pthread_mutex_init(&m_parse_lock, 0);
+	pthread_cond_init(&m_parse_cond, 0);
+}
+
+eDVBRecordFileThread::~eDVBRecordFileThread()
+{
+	stop();
+	stopParser();
+	pthread_cond_destroy(&m_parse_cond);
+	pthread_mutex_destroy(&m_parse_lock);
+	delete [] m_parse_data;
 }
 
 void eDVBRecordFileThread::setTimingPID(int pid, int type)
@@ -390,6 +418,8 @@ void eDVBRecordFileThread::startSaveMetaInformation(const std::string &filename)
 
 void eDVBRecordFileThread::stopSaveMetaInformation()
 {
+		/* the queued blocks still belong to the file */
+	stopParser();
 	m_stream_info.stopSave();
 }
 
@@ -403,21 +433,530 @@ int eDVBRecordFileThread::getLastPTS(pts_t &pts)
 	return m_ts_parser.getLastPTS(pts);
 }
 
+void eDVBRecordFileThread::getParserStatistics(parserStatistics &stats)
+{
+	singleLock s(m_parse_lock);
+	stats = m_parse_stats;
+}
+
+	/* called by the writer, the queued blocks are parsed from its buffer */
+unsigned char *eDVBRecordFileThread::nextBuffer(unsigned char *buffer)
+{
+	singleLock s(m_parse_lock);
+	if (m_parse_current >= 0 && !m_parse_refs[m_parse_current])
+		return buffer;
+		/* at most PARSE_BLOCKS buffers have queued blocks */
+	for (int i = 0; i <= PARSE_BLOCKS; ++i)
+	{
+		if (!m_parse_refs[i])
+		{
+			m_parse_current = i;
+			break;
+		}
+	}
+	return m_parse_data + m_parse_current * BUFFER_SIZE;
+}
+
+	/* called by the writer, which owns m_parse_write and the block there */
 int eDVBRecordFileThread::filterRecordData(const unsigned char *data, int len, size_t &current_span_remaining)
 {
-	m_ts_parser.parseData(m_current_offset, data, len);
-	
+	if (!m_parser_running)
+	{
+		m_parse_stop = false;
+		m_parser_running = true;
+		m_parser.run();
+	}
+
+	ASSERT(m_parse_current >= 0);
+	ASSERT(data >= m_parse_data + m_parse_current * BUFFER_SIZE && data + len <= m_parse_data + (m_parse_current + 1) * BUFFER_SIZE);
+
+	bool full;
+	int lag;
+	long long dropped;
+	{
+		singleLock s(m_parse_lock);
+		full = m_parse_queued == PARSE_BLOCKS;
+		if (full)
+		{
+			++m_parse_stats.overflows;
+			m_parse_stats.dropped += len;
+			m_parse_gap = true;
+		}
+		else
+		{
+			parseBlock &block = m_parse_block[m_parse_write];
+			block.data = data;
+			block.buffer = m_parse_current;
+			block.offset = m_current_offset;
+			block.len = len;
+			block.gap = m_parse_gap;
+			++m_parse_refs[m_parse_current];
+			m_parse_write = (m_parse_write + 1) % PARSE_BLOCKS;
+			m_parse_gap = false;
+			++m_parse_queued;
+			m_parse_stats.lag += len;
+			if (m_parse_stats.lag > m_parse_stats.max_lag)
+				m_parse_stats.max_lag = m_parse_stats.lag;
+			pthread_cond_signal(&m_parse_cond);
+		}
+		lag = m_parse_stats.lag;
+		dropped = m_parse_stats.dropped;
+	}
+
+	if (!full)
+		m_overflow_reported = false;
+	else if (!m_overflow_reported)
+	{
+		eWarning("[eDVBRecordFileThread] parser overflow, %lld bytes not parsed", dropped);
+		sendEvent(evtParserOverflow);
+		m_overflow_reported = true;
+	}
+
+	if (lag > PARSE_BLOCKS * BUFFER_SIZE / 2)
+	{
+		if (!m_lag_reported)
+		{
+			eDebug("[eDVBRecordFileThread] parser lags %d bytes behind", lag);
+			sendEvent(evtParserLag);
+			m_lag_reported = true;
+		}
+	}
+	else if (lag < PARSE_BLOCKS * BUFFER_SIZE / 4)
+		m_lag_reported = false;
+
 	m_current_offset += len;
-	
+
 	return len;
 }
 
+void eDVBRecordFileThread::parserThread::thread()
+{
+	hasStarted();
+	m_owner.parseLoop();
+}
+
+void eDVBRecordFileThread::parseLoop()
+{
+	singleLock s(m_parse_lock);
+	while (1)
+	{
+		while (!m_parse_queued && !m_parse_stop)
+			pthread_cond_wait(&m_parse_cond, &m_parse_lock);
+		if (!m_parse_queued) // stopped and drained
+			break;
+		parseBlock &block = m_parse_block[m_parse_read];
+		pthread_mutex_unlock(&m_parse_lock);
+
+		if (block.gap)
+			m_ts_parser.resync();
+		m_ts_parser.parseData(block.offset, block.data, block.len);
+
+		pthread_mutex_lock(&m_parse_lock);
+		--m_parse_refs[block.buffer];
+		m_parse_read = (m_parse_read + 1) % PARSE_BLOCKS;
+		--m_parse_queued;
+		m_parse_stats.lag -= block.len;
+	}
+}
+
+	/* parses the queued blocks and stops the parser, the writer must be stopped */
+void eDVBRecordFileThread::stopParser()
+{
+	if (!m_parser_running)
+		return;
+	{
+		singleLock s(m_parse_lock);
+		m_parse_stop = true;
+		pthread_cond_signal(&m_parse_cond);
+	}
+	m_parser.kill();
+	m_parser_running = false;
+	if (m_parse_stats.overflows)
+		eWarning("[eDVBRecordFileThread] %u blocks (%lld bytes) were not parsed, max lag %d bytes",
+			m_parse_stats.overflows, m_parse_stats.dropped, m_parse_stats.max_lag);
+}
+
+DEFINE_REF(eDVBRecordMux::sink);
+
+eDVBRecordMux::sink::sink(int index)
+	:m_index(index), m_head(0), m_tail(0), m_waiting(false), m_stopped(false),
+	m_dropped(0), m_overflow(false)
+{
+	m_ring = new unsigned char[RING_SIZE];
+	pthread_mutex_init(&m_lock, 0);
+	pthread_cond_init(&m_cond, 0);
+}
+
+eDVBRecordMux::sink::~sink()
+{
+	pthread_cond_destroy(&m_cond);
+	pthread_mutex_destroy(&m_lock);
+	delete [] m_ring;
+}
+
+	/* called by the reader, with whole packets. What doesn't fit is dropped. */
+void eDVBRecordMux::sink::put(const unsigned char *data, unsigned int len)
+{
+	unsigned int space = RING_SIZE - (m_head - m_tail);
+	if (len > space)
+	{
+		unsigned int fit = space - space % 188;
+		m_dropped += len - fit;
+		if (!m_overflow)
+		{
+			eWarning("[eDVBRecordMux] recording %d falls behind, dropping packets", m_index);
+			m_overflow = true;
+		}
+		len = fit;
+	}
+	else if (m_overflow)
+	{
+		eWarning("[eDVBRecordMux] recording %d caught up, %lld bytes dropped", m_index, m_dropped);
+		m_overflow = false;
+	}
+	unsigned int pos = m_head % RING_SIZE;
+	unsigned int first = RING_SIZE - pos;
+	if (first > len)
+		first = len;
+	memcpy(m_ring + pos, data, first);
+	memcpy(m_ring, data + first, len - first);
+		/* the packets before the new head */
+	__sync_synchronize();
+	m_head += len;
+}
+
+	/* called by the reader after it put a chunk */
+void eDVBRecordMux::sink::wakeup()
+{
+		/* pairs with the barrier in read: either it sees the new head,
+		   or we see it waiting */
+	__sync_synchronize();
+	if (m_waiting)
+	{
+		singleLock s(m_lock);
+		pthread_cond_signal(&m_cond);
+	}
+}
+
+ssize_t eDVBRecordMux::sink::read(off_t offset, void *buf, size_t count)
+{
+	unsigned int queued = m_head - m_tail;
+	if (!queued)
+	{
+		singleLock s(m_lock);
+		m_waiting = true;
+		__sync_synchronize();
+		while (!(queued = m_head - m_tail) && !m_stopped)
+			pthread_cond_wait(&m_cond, &m_lock);
+		m_waiting = false;
+		if (!queued)
+			return 0;
+	}
+		/* the packets behind the head we have seen */
+	__sync_synchronize();
+	if (count > queued)
+		count = queued;
+	count -= count % 188;
+	unsigned int pos = m_tail % RING_SIZE;
+	size_t first = RING_SIZE - pos;
+	if (first > count)
+		first = count;
+	memcpy(buf, m_ring + pos, first);
+	memcpy((unsigned char*)buf + first, m_ring, count - first);
+		/* the copy before the space is given back */
+	__sync_synchronize();
+	m_tail += count;
+	return count;
+}
+
+DEFINE_REF(eDVBRecordMux);
+
+eDVBRecordMux::eDVBRecordMux(eDVBDemux *demux)
+	:m_demux(demux), m_fd(-1), m_filter_pid(-1), m_stop(false), m_sinks(0), m_resyncs(0)
+{
+	m_wake[0] = m_wake[1] = -1;
+	memset(m_pid_sinks, 0, sizeof(m_pid_sinks));
+	memset(m_sink, 0, sizeof(m_sink));
+	pthread_mutex_init(&m_lock, 0);
+}
+
+eDVBRecordMux::~eDVBRecordMux()
+{
+	closeSource();
+	m_demux->m_record_mux = 0;
+	pthread_mutex_destroy(&m_lock);
+}
+
+RESULT eDVBRecordMux::attach(ePtr<sink> &s)
+{
+	singleLock l(m_lock);
+	for (int i = 0; i < MAX_SINKS; ++i)
+	{
+		if (m_sink[i])
+			continue;
+		s = m_sink[i] = new sink(i);
+		++m_sinks;
+		return 0;
+	}
+	return -EBUSY;
+}
+
+void eDVBRecordMux::detach(sink *s)
+{
+	{
+		singleLock l(m_lock);
+		for (int pid = 0; pid < 0x2000; ++pid)
+			releasePID(s, pid);
+		m_sink[s->m_index] = 0;
+		--m_sinks;
+	}
+	{
+		singleLock l(s->m_lock);
+		s->m_stopped = true;
+		pthread_cond_signal(&s->m_cond);
+	}
+	if (!m_sinks)
+		closeSource();
+}
+
+RESULT eDVBRecordMux::addPID(sink *s, int pid)
+{
+	if (pid < 0 || pid >= 0x2000)
+		return -1;
+	if (m_fd < 0 && openSource(pid))
+		return -1;
+	singleLock l(m_lock);
+	if (!m_pid_sinks[pid] && pid != m_filter_pid)
+	{
+		while (true)
+		{
+			__u16 p = pid;
+			if (::ioctl(m_fd, DMX_ADD_PID, &p) < 0)
+			{
+				perror("DMX_ADD_PID");
+				if (errno == EAGAIN || errno == EINTR)
+				{
+					eDebug("retry!");
+					continue;
+				}
+				return -1;
+			}
+			break;
+		}
+	}
+	m_pid_sinks[pid] |= 1U << s->m_index;
+	return 0;
+}
+
+void eDVBRecordMux::removePID(sink *s, int pid)
+{
+	if (pid < 0 || pid >= 0x2000)
+		return;
+	singleLock l(m_lock);
+	releasePID(s, pid);
+}
+
+	/* with m_lock held */
+void eDVBRecordMux::releasePID(sink *s, int pid)
+{
+	unsigned int bit = 1U << s->m_index;
+	if (!(m_pid_sinks[pid] & bit))
+		return;
+	m_pid_sinks[pid] &= ~bit;
+		/* the pid of the filter stays until the source is closed */
+	if (!m_pid_sinks[pid] && pid != m_filter_pid)
+	{
+		while (true)
+		{
+			__u16 p = pid;
+			if (::ioctl(m_fd, DMX_REMOVE_PID, &p) < 0)
+			{
+				perror("DMX_REMOVE_PID");
+				if (errno == EAGAIN || errno == EINTR)
+				{
+					eDebug("retry!");
+					continue;
+				}
+			}
+			break;
+		}
+	}
+}
+
+	/* opens the demux with a filter for the first pid and starts the reader */
+int eDVBRecordMux::openSource(int pid)
+{
+	char filename[128];
+	snprintf(filename, 128, "/dev/dvb/adapter%d/demux%d", m_demux->adapter, m_demux->demux);
+
+	m_fd = ::open(filename, O_RDONLY | O_NONBLOCK);
+	if (m_fd < 0)
+	{
+		eDebug("FAILED to open demux (%s) in record mux (%m)", filename);
+		return -1;
+	}
+
+		/* all recordings of the demux share this buffer */
+	if (::ioctl(m_fd, DMX_SET_BUFFER_SIZE, 4*1024*1024) < 0)
+		eDebug("eDVBRecordMux DMX_SET_BUFFER_SIZE failed(%m)");
+
+	dmx_pes_filter_params flt;
+	flt.pes_type = DMX_PES_OTHER;
+	flt.output  = DMX_OUT_TSDEMUX_TAP;
+	flt.pid     = pid;
+	flt.input   = DMX_IN_FRONTEND;
+	flt.flags   = 0;
+	if (::ioctl(m_fd, DMX_SET_PES_FILTER, &flt) < 0 || pipe(m_wake) < 0)
+	{
+		eDebug("eDVBRecordMux start failed: %m");
+		::close(m_fd);
+		m_fd = -1;
+		return -1;
+	}
+	::ioctl(m_fd, DMX_START);
+	m_filter_pid = pid;
+	m_stop = false;
+	run();
+	return 0;
+}
+
+void eDVBRecordMux::closeSource()
+{
+	if (m_fd < 0)
+		return;
+	m_stop = true;
+	char c = 0;
+	if (::write(m_wake[1], &c, 1) < 0)
+		eDebug("eDVBRecordMux wakeup failed: %m");
+	kill();
+	if (::ioctl(m_fd, DMX_STOP) < 0)
+		perror("DMX_STOP");
+	::close(m_fd);
+	::close(m_wake[0]);
+	::close(m_wake[1]);
+	m_fd = m_wake[0] = m_wake[1] = -1;
+	m_filter_pid = -1;
+	memset(m_pid_sinks, 0, sizeof(m_pid_sinks));
+}
+
+void eDVBRecordMux::thread()
+{
+	hasStarted();
+	int fill = 0;
+	while (!m_stop)
+	{
+		pollfd pfd[2];
+		pfd[0].fd = m_fd;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = m_wake[0];
+		pfd[1].events = POLLIN;
+		if (poll(pfd, 2, -1) < 0 && errno != EINTR)
+		{
+			eDebug("eDVBRecordMux poll failed: %m");
+			break;
+		}
+		if (m_stop)
+			break;
+		if (!pfd[0].revents)
+			continue;
+
+		ssize_t r = ::read(m_fd, m_buffer + fill, sizeof(m_buffer) - fill);
+		if (r < 0)
+		{
+			if (errno == EINTR || errno == EBUSY || errno == EAGAIN)
+				continue;
+			if (errno == EOVERFLOW)
+			{
+				eWarning("OVERFLOW while recording");
+					/* the rest of a partial packet was lost */
+				fill = 0;
+				continue;
+			}
+			eDebug("eDVBRecordMux *read error* (%m)");
+			usleep(100000);
+			continue;
+		}
+		fill += r;
+			/* the demux delivers whole packets, a short read is kept for
+			   the next one. after a lost sync the packets are found again */
+		int pos = 0;
+		while (1)
+		{
+			int skip = resync(m_buffer + pos, fill - pos);
+			if (skip)
+			{
+				if (!(m_resyncs++ % 100))
+					eWarning("[eDVBRecordMux] lost sync, %d bytes skipped (%d times)", skip, m_resyncs);
+				pos += skip;
+			}
+			int len = (fill - pos) - (fill - pos) % 188;
+			if (!len)
+				break;
+			int done = dispatch(m_buffer + pos, len);
+			pos += done;
+			if (done == len)
+				break;
+		}
+		memmove(m_buffer, m_buffer + pos, fill - pos);
+		fill -= pos;
+	}
+}
+
+	/* the number of bytes before the next packet start, confirmed by the
+	   sync bytes of the packets following it where they were read */
+int eDVBRecordMux::resync(const unsigned char *data, int len)
+{
+	if (!len || data[0] == 0x47)
+		return 0;
+	for (int i = 1; i < len; ++i)
+	{
+		if (data[i] == 0x47 && (i + 188 >= len || data[i + 188] == 0x47) &&
+			(i + 376 >= len || data[i + 376] == 0x47))
+			return i;
+	}
+	return len;
+}
+
+	/* returns the length of the packets up to the first one without sync byte */
+int eDVBRecordMux::dispatch(const unsigned char *data, int len)
+{
+	singleLock l(m_lock);
+	unsigned int touched = 0;
+	const unsigned char *start = data;
+	const unsigned char *end = data + len;
+	while (data < end && data[0] == 0x47)
+	{
+			/* the packets in a row which go to the same sinks are copied at once */
+		const unsigned char *run = data;
+		unsigned int mask = m_pid_sinks[((data[1] & 0x1f) << 8) | data[2]];
+		do
+			data += 188;
+		while (data < end && data[0] == 0x47 && m_pid_sinks[((data[1] & 0x1f) << 8) | data[2]] == mask);
+		touched |= mask;
+		while (mask)
+		{
+			int i = __builtin_ctz(mask);
+			mask &= mask - 1;
+			m_sink[i]->put(run, data - run);
+		}
+	}
+	while (touched)
+	{
+		int i = __builtin_ctz(touched);
+		touched &= touched - 1;
+		m_sink[i]->wakeup();
+	}
+	return data - start;
+}
+
 DEFINE_REF(eDVBTSRecorder);
 
 eDVBTSRecorder::eDVBTSRecorder(eDVBDemux *demux): m_demux(demux)
 {
 	m_running = 0;
 	m_target_fd = -1;
+	m_source_fd = -1;
+	m_share_demux = false;
 	m_thread = new eDVBRecordFileThread();
 	CONNECT(m_thread->m_event, eDVBTSRecorder::filepushEvent);
 }
@@ -441,6 +980,28 @@ RESULT eDVBTSRecorder::start()
 	if (i == m_pids.end())
 		return -3;
 
+		/* share the demux fd with the other recordings of the demux */
+	if (m_share_demux && !m_demux->getRecordMux(m_mux) && !m_mux->attach(m_sink))
+	{
+		if (!m_mux->addPID(m_sink, i->first))
+		{
+			m_pids[i->first] = 1;
+			if (m_target_filename != "")
+				m_thread->startSaveMetaInformation(m_target_filename);
+
+			ePtr<iTsSource> source = (eDVBRecordMux::sink*)m_sink;
+			m_thread->start(source, m_target_fd);
+			m_running = 1;
+
+			while (++i != m_pids.end())
+				startPID(i->first);
+			return 0;
+		}
+		m_mux->detach(m_sink);
+		m_sink = 0;
+	}
+	m_mux = 0;
+
 	char filename[128];
 	snprintf(filename, 128, "/dev/dvb/adapter%d/demux%d", m_demux->adapter, m_demux->demux);
 
@@ -488,6 +1049,9 @@ RESULT eDVBTSRecorder::start()
 
 RESULT eDVBTSRecorder::setBufferSize(int size)
 {
+		/* the record mux sizes the buffer of the shared fd itself */
+	if (m_source_fd < 0)
+		return -1;
 	int res = ::ioctl(m_source_fd, DMX_SET_BUFFER_SIZE, size);
 	if (res < 0)
 		eDebug("eDVBTSRecorder DMX_SET_BUFFER_SIZE failed(%m)");
@@ -556,6 +1120,26 @@ RESULT eDVBTSRecorder::setTimeshift(bool enable)
 	m_thread->setTimeshift(enable);
 }
 
+RESULT eDVBTSRecorder::setWriteMode(int mode, int buffersize)
+{
+	m_thread->setWriteMode(mode, buffersize);
+	return 0;
+}
+
+RESULT eDVBTSRecorder::setPreallocation(int bitrate, int duration)
+{
+	m_thread->setPreallocation(bitrate, duration);
+	return 0;
+}
+
+RESULT eDVBTSRecorder::setShareDemux(bool enable)
+{
+	if (m_running)
+		return -1;
+	m_share_demux = enable;
+	return 0;
+}
+
 RESULT eDVBTSRecorder::stop()
 {
 	int state=3;
@@ -566,6 +1150,18 @@ RESULT eDVBTSRecorder::stop()
 	if (!m_running)
 		return -1;
 
+	if (m_sink)
+	{
+			/* the record thread reads what is left and gets an EOF */
+		m_mux->detach(m_sink);
+		m_thread->stop();
+		m_sink = 0;
+		m_mux = 0;
+		m_running = 0;
+		m_thread->stopSaveMetaInformation();
+		return 0;
+	}
+
 	/* workaround for record thread stop */
 	if (m_source_fd >= 0)
 	{
@@ -617,6 +1213,12 @@ RESULT eDVBTSRecorder::connectEvent(const Slot1<void,int> &event, ePtr<eConnecti
 
 RESULT eDVBTSRecorder::startPID(int pid)
 {
+	if (m_sink)
+	{
+		if (!m_mux->addPID(m_sink, pid))
+			m_pids[pid] = 1;
+		return 0;
+	}
 	while(true) {
 		__u16 p = pid;
 		if (::ioctl(m_source_fd, DMX_ADD_PID, &p) < 0) {
@@ -634,7 +1236,9 @@ RESULT eDVBTSRecorder::startPID(int pid)
 
 void eDVBTSRecorder::stopPID(int pid)
 {
-	if (m_pids[pid] != -1)
+	if (m_pids[pid] != -1 && m_sink)
+		m_mux->removePID(m_sink, pid);
+	else if (m_pids[pid] != -1)
 	{
 		while(true) {
 			__u16 p = pid;
@@ -658,5 +1262,16 @@ void eDVBTSRecorder::filepushEvent(int event)
 	case eFilePushThread::evtWriteError:
 		m_event(eventWriteError);
 		break;
+	case eDVBRecordFileThread::evtParserOverflow:
+	case eDVBRecordFileThread::evtParserLag:
+	{
+		eDVBRecordFileThread::parserStatistics stats;
+		m_thread->getParserStatistics(stats);
+		eDebug("[eDVBTSRecorder] parser %s: %u blocks (%lld bytes) not parsed, lag %d, max lag %d bytes",
+			event == eDVBRecordFileThread::evtParserLag ? "lags" : "overflow",
+			stats.overflows, stats.dropped, stats.lag, stats.max_lag);
+		m_event(event == eDVBRecordFileThread::evtParserLag ? eventParserLag : eventParserOverflow);
+		break;
+	}
 	}
 }
@@ -5,6 +5,9 @@
 #include <lib/dvb/idemux.h>
 #include <lib/dvb/pvrparse.h>
 #include <lib/base/filepush.h>
+#include <lib/base/itssource.h>
+
+class eDVBRecordMux;
 
 class eDVBDemux: public iDVBDemux
 {
@@ -29,12 +32,15 @@ public:
 	RESULT flush();
 	RESULT connectEvent(const Slot1<void,int> &event, ePtr<eConnection> &conn);
 	int openDVR(int flags);
+		/* the reader shared by the recordings of this demux */
+	RESULT getRecordMux(ePtr<eDVBRecordMux> &mux);
 
 	int getRefCount() { return ref; }
 private:
 	int adapter, demux, source;
 	
 	int m_dvr_busy;
+	eDVBRecordMux *m_record_mux;
 	friend class eDVBSectionReader;
 	friend class eDVBPESReader;
 	friend class eDVBAudio;
@@ -43,6 +49,7 @@ private:
 	friend class eDVBTText;
 	friend class eDVBTSRecorder;
 	friend class eDVBCAService;
+	friend class eDVBRecordMux;
 	Signal1<void, int> m_event;
 	
 	int openDemux(void);
@@ -85,24 +92,152 @@ public:
 	RESULT connectRead(const Slot2<void,const __u8*, int> &read, ePtr<eConnection> &conn);
 };
 
+	/* the recorded data is parsed for the .ap/.sc files in a second
+	   thread, so a slow parse never delays the writer. The writer reads
+	   into the buffers of the parser and queues a reference to each
+	   block, a buffer is lent to the writer again when all its blocks are
+	   parsed. There is always one buffer more than blocks can be queued,
+	   so the writer never waits for the parser: when the queue is full,
+	   the block is only written, not parsed. */
 class eDVBRecordFileThread: public eFilePushThread
 {
 public:
 	eDVBRecordFileThread();
+	~eDVBRecordFileThread();
 	void setTimingPID(int pid, int type);
 	
 	void startSaveMetaInformation(const std::string &filename);
 	void stopSaveMetaInformation();
 	void enableAccessPoints(bool enable);
 	int getLastPTS(pts_t &pts);
+
+		/* sent through m_event when the parser starts dropping blocks,
+		   and when it lags more than half of the ring behind */
+	enum { evtParserOverflow = evtUser + 4, evtParserLag };
+	struct parserStatistics
+	{
+		unsigned int overflows; // blocks not parsed
+		long long dropped; // bytes not parsed
+		int lag, max_lag; // bytes queued for the parser
+	};
+	void getParserStatistics(parserStatistics &stats);
 protected:
 	int filterRecordData(const unsigned char *data, int len, size_t &current_span_remaining);
+	unsigned char *nextBuffer(unsigned char *buffer);
 private:
 	eMPEGStreamParserTS m_ts_parser;
 	eMPEGStreamInformation m_stream_info;
 	off_t m_current_offset;
 	pts_t m_last_pcr; /* very approximate.. */
 	int m_pid;
+
+	enum { PARSE_BLOCKS = 32 };
+	struct parseBlock
+	{
+		const unsigned char *data;
+		int buffer;
+		off_t offset;
+		int len;
+		bool gap; // blocks before this one were dropped
+	};
+	class parserThread: public eThread
+	{
+		eDVBRecordFileThread &m_owner;
+		void thread();
+	public:
+		parserThread(eDVBRecordFileThread &owner): m_owner(owner) { }
+	};
+	friend class parserThread;
+	parserThread m_parser;
+	unsigned char *m_parse_data; // PARSE_BLOCKS + 1 buffers
+	int m_parse_refs[PARSE_BLOCKS + 1]; // the queued blocks in each buffer
+	int m_parse_current; // the buffer lent to the writer, -1 before the first
+	parseBlock m_parse_block[PARSE_BLOCKS];
+	int m_parse_write, m_parse_read, m_parse_queued;
+	bool m_parse_gap, m_parse_stop, m_parser_running;
+	bool m_overflow_reported, m_lag_reported;
+	parserStatistics m_parse_stats;
+	pthread_mutex_t m_parse_lock;
+	pthread_cond_t m_parse_cond;
+	void parseLoop();
+	void stopParser();
+};
+
+	/* reads the packets of all recordings of a demux through a single
+	   demux fd and distributes them to the recordings in userspace. Each
+	   pid has a bitmap of the sinks recording it, so a packet is looked
+	   up once and only copied to the sinks which want it: the work grows
+	   with the recorded data, not with the number of recordings.
+
+	   Every sink has its own ring, which the record thread of its
+	   recording reads as an iTsSource. When a writer falls behind and its
+	   ring is full, its packets are dropped, the other recordings go on.
+	   The record threads read their rings like a file, so a recording
+	   through the mux is never spliced. It costs a copy and the ring of
+	   each sink, so only the recordings which enable setShareDemux use
+	   it, the others read their own demux fd.
+
+	   All but the reader thread and sink::read run in the mainloop. */
+class eDVBRecordMux: public iObject, public eThread
+{
+	DECLARE_REF(eDVBRecordMux);
+public:
+	enum { MAX_SINKS = 32, RING_SIZE = 2*1024*1024 }; // a power of 2, the ring positions wrap with unsigned int
+
+	class sink: public iTsSource
+	{
+		DECLARE_REF(sink);
+		friend class eDVBRecordMux;
+		int m_index;
+		unsigned char *m_ring;
+			/* written by the reader and the record thread only, they run
+			   free of each other and count up, m_head - m_tail is queued */
+		volatile unsigned int m_head, m_tail;
+		volatile bool m_waiting, m_stopped;
+		pthread_mutex_t m_lock;
+		pthread_cond_t m_cond;
+		long long m_dropped;
+		bool m_overflow;
+		void put(const unsigned char *data, unsigned int len);
+		void wakeup();
+	public:
+		sink(int index);
+		~sink();
+			/* blocks until packets are there, 0 after the sink was detached */
+		ssize_t read(off_t offset, void *buf, size_t count);
+		off_t lseek(off_t offset, int whence) { return (off_t)-1; }
+		off_t length() { return (off_t)-1; }
+		off_t offset() { return 0; }
+		int valid() { return 1; }
+		bool isStream() { return true; }
+	};
+
+	eDVBRecordMux(eDVBDemux *demux);
+	~eDVBRecordMux();
+
+		/* -EBUSY when all sinks are in use */
+	RESULT attach(ePtr<sink> &s);
+	void detach(sink *s);
+	RESULT addPID(sink *s, int pid);
+	void removePID(sink *s, int pid);
+private:
+	ePtr<eDVBDemux> m_demux;
+	int m_fd, m_filter_pid;
+	int m_wake[2];
+	volatile bool m_stop;
+	unsigned int m_pid_sinks[0x2000]; // bit n: m_sink[n] records the pid
+	sink *m_sink[MAX_SINKS];
+	int m_sinks;
+	pthread_mutex_t m_lock;
+	unsigned char m_buffer[188 * 512];
+	int m_resyncs; // only used by the reader
+
+	void thread();
+	int openSource(int pid);
+	void closeSource();
+	void releasePID(sink *s, int pid);
+	static int resync(const unsigned char *data, int len);
+	int dispatch(const unsigned char *data, int len);
 };
 
 class eDVBTSRecorder: public iDVBTSRecorder, public Object
@@ -124,6 +259,9 @@ public:
 	RESULT enableAccessPoints(bool enable);
 	RESULT setBoundary(off_t max);
 	RESULT setTimeshift(bool enable);
+	RESULT setWriteMode(int mode, int buffersize);
+	RESULT setPreallocation(int bitrate, int duration);
+	RESULT setShareDemux(bool enable);
 	
 	RESULT stop();
 
@@ -136,6 +274,10 @@ private:
 	
 	eDVBRecordFileThread *m_thread;
 	void filepushEvent(int event);
+
+		/* the shared reader, else the recorder has its own demux fd */
+	ePtr<eDVBRecordMux> m_mux;
+	ePtr<eDVBRecordMux::sink> m_sink;
 	
 	std::map<int,int> m_pids;
 	Signal1<void,int> m_event;
@@ -143,6 +285,7 @@ private:
 	ePtr<eDVBDemux> m_demux;
 	
 	int m_running, m_target_fd, m_source_fd;
+	bool m_share_demux;
 	std::string m_target_filename;
 };
 
@@ -10,18 +10,29 @@
 #include <time.h>
 #include <unistd.h>  // for usleep
 #include <sys/vfs.h> // for statfs
+#include <sys/mman.h>
+#include <sys/stat.h>
 // #include <libmd5sum.h>
 #include <lib/base/eerror.h>
 #include <lib/base/estring.h>
 #include <lib/dvb/pmt.h>
 #include <lib/dvb/db.h>
+#include <lib/dvb/crc32.h>
+#include <lib/dvb/epgpack.h>
+#include <lib/dvb/epgdecoder.h>
 #include <lib/python/python.h>
 #include <dvbsi++/descriptor_tag.h>
 
 int eventData::CacheSize=0;
-descriptorMap eventData::descriptors;
+eEPGTitleIndex eventData::titles;
+eEPGDescriptorStore eventData::descriptors(&eventData::titles);
 __u8 eventData::data[4108];
-extern const uint32_t crc32_table[256];
+pthread_mutex_t eventData::arena_lock=
+	PTHREAD_MUTEX_INITIALIZER;
+eSlabAllocator eventData::arena(64*1024);
+__u8 *eventData::mapped_data;
+size_t eventData::mapped_size;
+int eventData::mapped_refs;
 
 const eServiceReference &handleGroup(const eServiceReference &ref)
 {
@@ -54,6 +65,7 @@ eventData::eventData(const eit_event_struct* e, int size, int type)
 
 	__u32 descr[65];
 	__u32 *pdescr=descr;
+	int added=0;
 
 	__u8 *data = (__u8*)e;
 	int ptr=12;
@@ -77,18 +89,8 @@ eventData::eventData(const eit_event_struct* e, int size, int type)
 					int cnt=0;
 					while(cnt++ < descr_len)
 						crc = (crc << 8) ^ crc32_table[((crc >> 24) ^ data[ptr++]) & 0xFF];
-	
-					descriptorMap::iterator it =
-						descriptors.find(crc);
-					if ( it == descriptors.end() )
-					{
-						CacheSize+=descr_len;
-						__u8 *d = new __u8[descr_len];
-						memcpy(d, descr, descr_len);
-						descriptors[crc] = descriptorPair(1, d);
-					}
-					else
-						++it->second.first;
+
+					added += descriptors.ref(crc, descr);
 					*pdescr++=crc;
 					break;
 				}
@@ -103,8 +105,11 @@ eventData::eventData(const eit_event_struct* e, int size, int type)
 	}
 	ASSERT(pdescr <= &descr[65]);
 	ByteSize = 10+((pdescr-descr)*4);
-	EITdata = new __u8[ByteSize];
-	CacheSize+=ByteSize;
+	{
+		singleLock s(arena_lock);
+		EITdata = (__u8*)arena.alloc(ByteSize);
+		CacheSize+=ByteSize+added;
+	}
 	memcpy(EITdata, (__u8*) e, 10);
 	memcpy(EITdata+10, descr, ByteSize-10);
 }
@@ -118,12 +123,11 @@ const eit_event_struct* eventData::get() const
 	__u32 *p = (__u32*)(EITdata+10);
 	while(tmp>3)
 	{
-		descriptorMap::iterator it =
-			descriptors.find(*p++);
-		if ( it != descriptors.end() )
+		const __u8 *descr = descriptors.lookup(*p++);
+		if ( descr )
 		{
-			int b = it->second.second[1]+2;
-			memcpy(data+pos, it->second.second, b );
+			int b = descr[1]+2;
+			memcpy(data+pos, descr, b );
 			pos += b;
 			descriptors_length += b;
 		}
@@ -141,67 +145,74 @@ eventData::~eventData()
 {
 	if ( ByteSize )
 	{
-		CacheSize -= ByteSize;
+		int size = ByteSize;
+		int freed = 0;
+		int mapped = 0;
 		__u32 *d = (__u32*)(EITdata+10);
 		ByteSize -= 10;
 		while(ByteSize>3)
 		{
-			descriptorMap::iterator it =
-				descriptors.find(*d++);
-			if ( it != descriptors.end() )
-			{
-				descriptorPair &p = it->second;
-				if (!--p.first) // no more used descriptor
-				{
-					CacheSize -= it->second.second[1];
-					delete [] it->second.second;  	// free descriptor memory
-					descriptors.erase(it);	// remove entry from descriptor map
-				}
-			}
-			else
+			int ret = descriptors.unref(*d++, &mapped); // frees no more used descriptors
+			if ( ret < 0 )
 				eFatal("LINE %d descriptor not found in descriptor cache %08x!!!!!!", __LINE__, *(d-1));
+			freed += ret;
 			ByteSize -= 4;
 		}
-		delete [] EITdata;
+		singleLock s(arena_lock);
+		CacheSize -= size + freed;
+		if (isMapped())
+			++mapped;
+		else
+			arena.free(EITdata, size);
+		if (mapped)
+			releaseMapped(mapped);
 	}
 }
 
-void eventData::load(FILE *f)
+void *eventData::operator new(size_t size)
 {
-	int size=0;
-	int id=0;
-	__u8 header[2];
-	descriptorPair p;
-	fread(&size, sizeof(int), 1, f);
-	while(size)
+	singleLock s(arena_lock);
+	return arena.alloc(size);
+}
+
+void eventData::operator delete(void *p, size_t size)
+{
+	singleLock s(arena_lock);
+	arena.free(p, size);
+}
+
+void eventData::releaseMapped(int refs)
+{
+	mapped_refs -= refs;
+	if (mapped_refs <= 0 && mapped_data)
 	{
-		fread(&id, sizeof(__u32), 1, f);
-		fread(&p.first, sizeof(int), 1, f);
-		fread(header, 2, 1, f);
-		int bytes = header[1]+2;
-		p.second = new __u8[bytes];
-		p.second[0] = header[0];
-		p.second[1] = header[1];
-		fread(p.second+2, bytes-2, 1, f);
-		descriptors[id]=p;
-		--size;
-		CacheSize+=bytes;
+		eDebug("[EPGC] all events of the mapped epg file are gone, unmap it");
+		munmap(mapped_data, mapped_size);
+		mapped_data = 0;
+		mapped_size = 0;
+		mapped_refs = 0;
 	}
 }
 
-void eventData::save(FILE *f)
+void eventData::load(FILE *f)
 {
-	int size=descriptors.size();
-	descriptorMap::iterator it(descriptors.begin());
-	fwrite(&size, sizeof(int), 1, f);
+	int size=0;
+	__u32 id=0;
+	int refcount=0;
+	int bytes=0;
+	__u8 descr[257];
+	fread(&size, sizeof(int), 1, f);
 	while(size)
 	{
-		fwrite(&it->first, sizeof(__u32), 1, f);
-		fwrite(&it->second.first, sizeof(int), 1, f);
-		fwrite(it->second.second, it->second.second[1]+2, 1, f);
-		++it;
+		fread(&id, sizeof(__u32), 1, f);
+		fread(&refcount, sizeof(int), 1, f);
+		fread(descr, 2, 1, f);
+		fread(descr+2, descr[1], 1, f);
+		bytes += descriptors.ref(id, descr, refcount);
 		--size;
 	}
+	singleLock s(arena_lock);
+	CacheSize+=bytes;
 }
 
 eEPGCache* eEPGCache::instance;
@@ -213,13 +224,18 @@ pthread_mutex_t eEPGCache::channel_map_lock=
 DEFINE_REF(eEPGCache)
 
 eEPGCache::eEPGCache()
-	:messages(this,1), cleanTimer(eTimer::create(this)), m_running(0)//, paused(0)
+	:messages(this,1), cleanTimer(eTimer::create(this)), checkpointTimer(eTimer::create(this)), m_running(0)//, paused(0)
+	,m_writer(0), m_generation(0), m_snapshot_generation(0), m_pending_snapshots(0), m_have_snapshot(false), m_journal_size(0), m_decoder(0)
+	,m_section_hits(0), m_section_misses(0), m_section_entries(0)
+	,m_clean_all(true), m_last_housekeeping(0), m_decoded_hits(0), m_decoded_misses(0)
 {
 	eDebug("[EPGC] Initialized EPGCache (wait for setCacheFile call now)");
 
 	CONNECT(messages.recv_msg, eEPGCache::gotMessage);
-	CONNECT(eDVBLocalTimeHandler::getInstance()->m_timeUpdated, eEPGCache::timeUpdated);
+	if (eDVBLocalTimeHandler::getInstance()) // not in enigma-epgbench
+		CONNECT(eDVBLocalTimeHandler::getInstance()->m_timeUpdated, eEPGCache::timeUpdated);
 	CONNECT(cleanTimer->timeout, eEPGCache::cleanLoop);
+	CONNECT(checkpointTimer->timeout, eEPGCache::checkpoint);
 
 	ePtr<eDVBResourceManager> res_mgr;
 	eDVBResourceManager::getInstance(res_mgr);
@@ -442,14 +458,14 @@ bool eEPGCache::FixOverlapping(std::pair<eventMap,timeMap> &servicemap, time_t T
 				event.getExtendedDescription().c_str());
 #endif
 			delete tmp->second;
+			ret = true;
 			if (tmp == servicemap.second.begin())
 			{
 				servicemap.second.erase(tmp);
 				break;
 			}
 			else
-				servicemap.second.erase(tmp--);
-			ret = true;
+				tmp = servicemap.second.erase(tmp) - 1;
 		}
 		else
 		{
@@ -459,7 +475,8 @@ bool eEPGCache::FixOverlapping(std::pair<eventMap,timeMap> &servicemap, time_t T
 		}
 	}
 
-	tmp = tm_it;
+	// tm_it is not valid anymore when events before it were erased
+	tmp = ret ? servicemap.second.find(TM) : tm_it;
 	while(tmp->first < (TM+duration-300))
 	{
 		if (tmp->first != TM && tmp->second->type != PRIVATE)
@@ -477,7 +494,7 @@ bool eEPGCache::FixOverlapping(std::pair<eventMap,timeMap> &servicemap, time_t T
 				event.getExtendedDescription().c_str());
 #endif
 			delete tmp->second;
-			servicemap.second.erase(tmp++);
+			tmp = servicemap.second.erase(tmp);
 			ret = true;
 		}
 		else
@@ -488,19 +505,26 @@ bool eEPGCache::FixOverlapping(std::pair<eventMap,timeMap> &servicemap, time_t T
 	return ret;
 }
 
-void eEPGCache::sectionRead(const __u8 *data, int source, channel_data *channel)
+// returns the offset of the first event in the section, 0 when it has none
+static int eitEventOffset(const __u8 *data)
 {
 	eit_t *eit = (eit_t*) data;
 
 	int len=HILO(eit->section_length)-1;//+3-4;
 	int ptr=EIT_SIZE;
 	if ( ptr >= len )
-		return;
+		return 0;
 
 	// This fixed the EPG on the Multichoice irdeto systems
 	// the EIT packet is non-compliant.. their EIT packet stinks
 	if ( data[ptr-1] < 0x40 )
 		--ptr;
+	return ptr;
+}
+
+uniqueEPGKey eEPGCache::sectionService(const __u8 *data, int source, channel_data *channel)
+{
+	eit_t *eit = (eit_t*) data;
 
 	// Cablecom HACK .. tsid / onid in eit data are incorrect.. so we use
 	// it from running channel (just for current transport stream eit data)
@@ -510,27 +534,132 @@ void eEPGCache::sectionRead(const __u8 *data, int source, channel_data *channel)
 		use_transponder_chid ? chid.original_network_id.get() : HILO(eit->original_network_id),
 		use_transponder_chid ? chid.transport_stream_id.get() : HILO(eit->transport_stream_id));
 
+	int ptr = eitEventOffset(data);
+	if (ptr)
+	{
+		eit_event_struct* eit_event = (eit_event_struct*) (data+ptr);
+		time_t TM = parseDVBtime(
+				eit_event->start_time_1,
+				eit_event->start_time_2,
+				eit_event->start_time_3,
+				eit_event->start_time_4,
+				eit_event->start_time_5);
+		if ( TM != 3599 && TM > -1)
+			channel->haveData |= source;
+	}
+	return service;
+}
+
+static inline __u64 sectionKey(const uniqueEPGKey &service, const __u8 *data)
+{
+	eit_t *eit = (eit_t*) data;
+	return ((__u64)(service.sid & 0xFFFF) << 48) | ((__u64)(service.onid & 0xFFFF) << 32) |
+		((__u64)(service.tsid & 0xFFFF) << 16) | (data[0] << 8) | eit->section_number;
+}
+
+static inline __u32 sectionCRC(const __u8 *data)
+{
+	int size = (((data[1] & 0x0F) << 8) | data[2]) + 3;
+	return (data[size-4] << 24) | (data[size-3] << 16) | (data[size-2] << 8) | data[size-1];
+}
+
+bool eEPGCache::sectionUnchanged(const uniqueEPGKey &service, const __u8 *data)
+{
+	eit_t *eit = (eit_t*) data;
+	sectionFingerprint fp;
+	fp.crc = sectionCRC(data);
+	fp.version = eit->version_number;
+	sectionGenerations::iterator gen = m_section_generations.find(service);
+	fp.generation = gen != m_section_generations.end() ? gen->second : 0;
+	fp.time = ::time(0);
+
+	sectionFingerprint &entry = m_section_fingerprints[sectionKey(service, data)];
+	// events more than 14 days ahead are skipped by parseSection, so the
+	// sections are decoded again after some time
+	if (entry.time && entry.crc == fp.crc && entry.version == fp.version &&
+		entry.generation == fp.generation && fp.time - entry.time < SECTION_FINGERPRINT_TIMEOUT)
+	{
+		++m_section_hits;
+		return true;
+	}
+	entry = fp;
+	m_section_entries = m_section_fingerprints.size();
+	++m_section_misses;
+	return false;
+}
+
+
+void eEPGCache::queueSection(const __u8 *data, int source, channel_data *channel)
+{
+	uniqueEPGKey service = sectionService(data, source, channel);
+	if (sectionUnchanged(service, data))
+		return;
+	if (m_decoder)
+		m_decoder->push(data, source, service);
+	else
+		sectionRead(data, source, channel);
+}
+
+void eEPGCache::sectionRead(const __u8 *data, int source, channel_data *channel)
+{
+	sectionRead(sectionService(data, source, channel), data, source);
+}
+
+void eEPGCache::replaySection(const __u8 *data)
+{
+	int source;
+	switch(data[0])
+	{
+		case 0x4E ... 0x4F:
+			source=NOWNEXT;
+			break;
+		case 0x50 ... 0x5F:
+			source=SCHEDULE;
+			break;
+		case 0x60 ... 0x6F:
+			source=SCHEDULE_OTHER;
+			break;
+		default:
+			return;
+	}
+	eit_t *eit = (eit_t*) data;
+	sectionRead(uniqueEPGKey(HILO(eit->service_id), HILO(eit->original_network_id), HILO(eit->transport_stream_id)), data, source);
+}
+
+void eEPGCache::sectionRead(const uniqueEPGKey &service, const __u8 *data, int source)
+{
+	// create the eventData objects, which interns their descriptors, before
+	// taking cache_lock. lookups from other threads are blocked only while
+	// the maps are updated
+	eventData *events[4096/EIT_LOOP_SIZE];
+	int count = parseSection(data, source, events);
+	if (!count)
+		return;
+
+	{
+		singleLock s(cache_lock);
+		mergeEvents(service, source, events, count);
+	}
+
+	// events which were not taken are freed without holding cache_lock
+	for (int i = 0; i < count; ++i)
+		delete events[i];
+}
+
+int eEPGCache::parseSection(const __u8 *data, int source, eventData **events)
+{
+	eit_t *eit = (eit_t*) data;
+	int len=HILO(eit->section_length)-1;//+3-4;
+	int ptr=eitEventOffset(data);
+	if (!ptr)
+		return 0;
+
 	eit_event_struct* eit_event = (eit_event_struct*) (data+ptr);
 	int eit_event_size;
 	int duration;
-
-	time_t TM = parseDVBtime(
-			eit_event->start_time_1,
-			eit_event->start_time_2,
-			eit_event->start_time_3,
-			eit_event->start_time_4,
-			eit_event->start_time_5);
+	time_t TM;
 	time_t now = ::time(0);
-
-	if ( TM != 3599 && TM > -1)
-		channel->haveData |= source;
-
-	singleLock s(cache_lock);
-	// hier wird immer eine eventMap zurck gegeben.. entweder eine vorhandene..
-	// oder eine durch [] erzeugte
-	std::pair<eventMap,timeMap> &servicemap = eventDB[service];
-	eventMap::iterator prevEventIt = servicemap.first.end();
-	timeMap::iterator prevTimeIt = servicemap.second.end();
+	int count = 0;
 
 	while (ptr<len)
 	{
@@ -546,180 +675,196 @@ void eEPGCache::sectionRead(const __u8 *data, int source, channel_data *channel)
 			eit_event->start_time_5,
 			&event_hash);
 
-		if ( TM == 3599 )
-			goto next;
-
-		if ( TM != 3599 && (TM+duration < now || TM > now+14*24*60*60) )
-			goto next;
-
-		if ( now <= (TM+duration) || TM == 3599 /*NVOD Service*/ )  // old events should not be cached
+		// old events should not be cached
+		if ( TM != 3599 && TM+duration >= now && TM <= now+14*24*60*60 )
 		{
-			__u16 event_id = HILO(eit_event->event_id);
-			eventData *evt = 0;
-			int ev_erase_count = 0;
-			int tm_erase_count = 0;
-
-			if (event_id == 0) {
+			if (HILO(eit_event->event_id) == 0) {
 				// hack for some polsat services on 13.0E..... but this also replaces other valid event_ids with value 0..
 				// but we dont care about it...
-				event_id = event_hash;
 				eit_event->event_id_hi = event_hash >> 8;
 				eit_event->event_id_lo = event_hash & 0xFF;
 			}
+			events[count++] = new eventData(eit_event, eit_event_size, source);
+		}
 
-			// search in eventmap
-			eventMap::iterator ev_it =
-				servicemap.first.find(event_id);
+		ptr += eit_event_size;
+		eit_event=(eit_event_struct*)(((__u8*)eit_event)+eit_event_size);
+	}
+	return count;
+}
+
+// takes the events into the cache, taken events are set to 0 in events.
+// must be called with cache_lock held
+void eEPGCache::mergeEvents(const uniqueEPGKey &service, int source, eventData **events, int count)
+{
+	time_t TM;
+	int duration;
+	// hier wird immer eine eventMap zurck gegeben.. entweder eine vorhandene..
+	// oder eine durch [] erzeugte
+	std::pair<eventMap,timeMap> &servicemap = eventDB[service];
+	m_dirty.insert(service);
+	// set when events are removed which may come from other sections
+	bool removed = false;
+
+	for (int i = 0; i < count; ++i)
+	{
+		eventData *evt = events[i];
+		__u16 event_id = evt->getEventID();
+		int ev_erase_count = 0;
+		int tm_erase_count = 0;
+
+		TM = evt->getStartTime();
+		duration = evt->getDuration();
+
+		// search in eventmap
+		eventMap::iterator ev_it =
+			servicemap.first.find(event_id);
 
 //			eDebug("event_id is %d sid is %04x", event_id, service.sid);
 
-			// entry with this event_id is already exist ?
-			if ( ev_it != servicemap.first.end() )
-			{
-				if ( source > ev_it->second->type )  // update needed ?
-					goto next; // when not.. then skip this entry
+		// entry with this event_id is already exist ?
+		if ( ev_it != servicemap.first.end() )
+		{
+			if ( source > ev_it->second->type )  // update needed ?
+				continue; // when not.. then skip this entry
 
-				// search this event in timemap
-				timeMap::iterator tm_it_tmp =
-					servicemap.second.find(ev_it->second->getStartTime());
+			// search this event in timemap
+			timeMap::iterator tm_it_tmp =
+				servicemap.second.find(ev_it->second->getStartTime());
 
-				if ( tm_it_tmp != servicemap.second.end() )
+			if ( tm_it_tmp != servicemap.second.end() )
+			{
+				if ( tm_it_tmp->first == TM ) // just update eventdata
 				{
-					if ( tm_it_tmp->first == TM ) // just update eventdata
-					{
-						// exempt memory
-						eventData *tmp = ev_it->second;
-						ev_it->second = tm_it_tmp->second =
-							new eventData(eit_event, eit_event_size, source);
-						if (FixOverlapping(servicemap, TM, duration, tm_it_tmp, service))
-						{
-							prevEventIt = servicemap.first.end();
-							prevTimeIt = servicemap.second.end();
-						}
-						delete tmp;
-						goto next;
-					}
-					else  // event has new event begin time
-					{
-						tm_erase_count++;
-						// delete the found record from timemap
-						servicemap.second.erase(tm_it_tmp);
-						prevTimeIt=servicemap.second.end();
-					}
+					// exempt memory
+					eventData *tmp = ev_it->second;
+					ev_it->second = tm_it_tmp->second = evt;
+					events[i] = 0;
+					invalidateDecoded(service, event_id);
+					removed |= FixOverlapping(servicemap, TM, duration, tm_it_tmp, service);
+					delete tmp;
+					continue;
+				}
+				else  // event has new event begin time
+				{
+					tm_erase_count++;
+					// delete the found record from timemap
+					servicemap.second.erase(tm_it_tmp);
 				}
 			}
+		}
 
-			// search in timemap, for check of a case if new time has coincided with time of other event
-			// or event was is not found in eventmap
-			timeMap::iterator tm_it =
-				servicemap.second.find(TM);
+		// search in timemap, for check of a case if new time has coincided with time of other event
+		// or event was is not found in eventmap
+		timeMap::iterator tm_it =
+			servicemap.second.find(TM);
 
-			if ( tm_it != servicemap.second.end() )
-			{
-				// event with same start time but another event_id...
-				if ( source > tm_it->second->type &&
-					ev_it == servicemap.first.end() )
-					goto next; // when not.. then skip this entry
+		if ( tm_it != servicemap.second.end() )
+		{
+			// event with same start time but another event_id...
+			if ( source > tm_it->second->type &&
+				ev_it == servicemap.first.end() )
+				continue; // when not.. then skip this entry
 
-				// search this time in eventmap
-				eventMap::iterator ev_it_tmp =
-					servicemap.first.find(tm_it->second->getEventID());
+			// search this time in eventmap
+			eventMap::iterator ev_it_tmp =
+				servicemap.first.find(tm_it->second->getEventID());
 
-				if ( ev_it_tmp != servicemap.first.end() )
-				{
-					ev_erase_count++;
-					// delete the found record from eventmap
-					servicemap.first.erase(ev_it_tmp);
-					prevEventIt=servicemap.first.end();
-				}
-			}
-			evt = new eventData(eit_event, eit_event_size, source);
-#ifdef EPG_DEBUG
-			bool consistencyCheck=true;
-#endif
-			if (ev_erase_count > 0 && tm_erase_count > 0) // 2 different pairs have been removed
-			{
-				// exempt memory
-				delete ev_it->second;
-				delete tm_it->second;
-				ev_it->second=evt;
-				tm_it->second=evt;
-			}
-			else if (ev_erase_count == 0 && tm_erase_count > 0)
+			if ( ev_it_tmp != servicemap.first.end() )
 			{
-				// exempt memory
-				delete ev_it->second;
-				tm_it=prevTimeIt=servicemap.second.insert( prevTimeIt, std::pair<const time_t, eventData*>( TM, evt ) );
-				ev_it->second=evt;
+				ev_erase_count++;
+				removed = true;
+				// delete the found record from eventmap
+				servicemap.first.erase(ev_it_tmp);
+				// erasing from the flat eventmap moves the entries behind it
+				ev_it = servicemap.first.find(event_id);
 			}
-			else if (ev_erase_count > 0 && tm_erase_count == 0)
-			{
-				// exempt memory
-				delete tm_it->second;
-				ev_it=prevEventIt=servicemap.first.insert( prevEventIt, std::pair<const __u16, eventData*>( event_id, evt) );
-				tm_it->second=evt;
-			}
-			else // added new eventData
-			{
+		}
+		events[i] = 0; // taken by the maps
+		invalidateDecoded(service, event_id);
 #ifdef EPG_DEBUG
-				consistencyCheck=false;
+		bool consistencyCheck=true;
 #endif
-				ev_it=prevEventIt=servicemap.first.insert( prevEventIt, std::pair<const __u16, eventData*>( event_id, evt) );
-				tm_it=prevTimeIt=servicemap.second.insert( prevTimeIt, std::pair<const time_t, eventData*>( TM, evt ) );
-			}
-
+		if (ev_erase_count > 0 && tm_erase_count > 0) // 2 different pairs have been removed
+		{
+			// exempt memory
+			delete ev_it->second;
+			delete tm_it->second;
+			ev_it->second=evt;
+			tm_it->second=evt;
+		}
+		else if (ev_erase_count == 0 && tm_erase_count > 0)
+		{
+			// exempt memory
+			delete ev_it->second;
+			tm_it=servicemap.second.insert( timeMap::value_type( TM, evt ) ).first;
+			ev_it->second=evt;
+		}
+		else if (ev_erase_count > 0 && tm_erase_count == 0)
+		{
+			// exempt memory
+			delete tm_it->second;
+			ev_it=servicemap.first.insert( eventMap::value_type( event_id, evt ) ).first;
+			tm_it->second=evt;
+		}
+		else // added new eventData
+		{
 #ifdef EPG_DEBUG
-			if ( consistencyCheck )
-			{
-				if ( tm_it->second != evt || ev_it->second != evt )
-					eFatal("tm_it->second != ev_it->second");
-				else if ( tm_it->second->getStartTime() != tm_it->first )
-					eFatal("event start_time(%d) non equal timemap key(%d)",
-						tm_it->second->getStartTime(), tm_it->first );
-				else if ( tm_it->first != TM )
-					eFatal("timemap key(%d) non equal TM(%d)",
-						tm_it->first, TM);
-				else if ( ev_it->second->getEventID() != ev_it->first )
-					eFatal("event_id (%d) non equal event_map key(%d)",
-						ev_it->second->getEventID(), ev_it->first);
-				else if ( ev_it->first != event_id )
-					eFatal("eventmap key(%d) non equal event_id(%d)",
-						ev_it->first, event_id );
-			}
+			consistencyCheck=false;
 #endif
-			if (FixOverlapping(servicemap, TM, duration, tm_it, service))
-			{
-				prevEventIt = servicemap.first.end();
-				prevTimeIt = servicemap.second.end();
-			}
+			ev_it=servicemap.first.insert( eventMap::value_type( event_id, evt ) ).first;
+			tm_it=servicemap.second.insert( timeMap::value_type( TM, evt ) ).first;
 		}
-next:
+
 #ifdef EPG_DEBUG
-		if ( servicemap.first.size() != servicemap.second.size() )
+		if ( consistencyCheck )
 		{
-			FILE *f = fopen("/hdd/event_map.txt", "w+");
-			int i=0;
-			for (eventMap::iterator it(servicemap.first.begin())
-				; it != servicemap.first.end(); ++it )
+			if ( tm_it->second != evt || ev_it->second != evt )
+				eFatal("tm_it->second != ev_it->second");
+			else if ( tm_it->second->getStartTime() != tm_it->first )
+				eFatal("event start_time(%d) non equal timemap key(%d)",
+					tm_it->second->getStartTime(), tm_it->first );
+			else if ( tm_it->first != TM )
+				eFatal("timemap key(%d) non equal TM(%d)",
+					tm_it->first, TM);
+			else if ( ev_it->second->getEventID() != ev_it->first )
+				eFatal("event_id (%d) non equal event_map key(%d)",
+					ev_it->second->getEventID(), ev_it->first);
+			else if ( ev_it->first != event_id )
+				eFatal("eventmap key(%d) non equal event_id(%d)",
+					ev_it->first, event_id );
+		}
+#endif
+		removed |= FixOverlapping(servicemap, TM, duration, tm_it, service);
+	}
+	// the sections of the removed events must be decoded again when they
+	// are received next time, also when their crc did not change
+	if (removed)
+		++m_section_generations[service];
+#ifdef EPG_DEBUG
+	if ( servicemap.first.size() != servicemap.second.size() )
+	{
+		FILE *f = fopen("/hdd/event_map.txt", "w+");
+		int i=0;
+		for (eventMap::iterator it(servicemap.first.begin())
+			; it != servicemap.first.end(); ++it )
+			fprintf(f, "%d(key %d) -> time %d, event_id %d, data %p\n", 
+				i++, (int)it->first, (int)it->second->getStartTime(), (int)it->second->getEventID(), it->second );
+		fclose(f);
+		f = fopen("/hdd/time_map.txt", "w+");
+		i=0;
+		for (timeMap::iterator it(servicemap.second.begin())
+			; it != servicemap.second.end(); ++it )
 				fprintf(f, "%d(key %d) -> time %d, event_id %d, data %p\n", 
 					i++, (int)it->first, (int)it->second->getStartTime(), (int)it->second->getEventID(), it->second );
-			fclose(f);
-			f = fopen("/hdd/time_map.txt", "w+");
-			i=0;
-			for (timeMap::iterator it(servicemap.second.begin())
-				; it != servicemap.second.end(); ++it )
-					fprintf(f, "%d(key %d) -> time %d, event_id %d, data %p\n", 
-						i++, (int)it->first, (int)it->second->getStartTime(), (int)it->second->getEventID(), it->second );
-			fclose(f);
+		fclose(f);
 
-			eFatal("(1)map sizes not equal :( sid %04x tsid %04x onid %04x size %d size2 %d", 
-				service.sid, service.tsid, service.onid, 
-				servicemap.first.size(), servicemap.second.size() );
-		}
-#endif
-		ptr += eit_event_size;
-		eit_event=(eit_event_struct*)(((__u8*)eit_event)+eit_event_size);
+		eFatal("(1)map sizes not equal :( sid %04x tsid %04x onid %04x size %d size2 %d", 
+			service.sid, service.tsid, service.onid, 
+			servicemap.first.size(), servicemap.second.size() );
 	}
+#endif
+	scheduleClean(service, servicemap.second);
 }
 
 void eEPGCache::flushEPG(const uniqueEPGKey & s)
@@ -728,6 +873,17 @@ void eEPGCache::flushEPG(const uniqueEPGKey & s)
 	singleLock l(cache_lock);
 	if (s)  // clear only this service
 	{
+		m_dirty.insert(s);
+		// the sections of this service must be decoded again
+		__u64 key = ((__u64)(s.sid & 0xFFFF) << 48) | ((__u64)(s.onid & 0xFFFF) << 32) | ((__u64)(s.tsid & 0xFFFF) << 16);
+		for (__gnu_cxx::hash_map<__u64, sectionFingerprint, hash_sectionKey>::iterator i = m_section_fingerprints.begin(); i != m_section_fingerprints.end(); )
+		{
+			if ((i->first & ~0xFFFFULL) == key)
+				m_section_fingerprints.erase(i++);
+			else
+				++i;
+		}
+		m_section_entries = m_section_fingerprints.size();
 		eventCache::iterator it = eventDB.find(s);
 		if ( it != eventDB.end() )
 		{
@@ -744,10 +900,7 @@ void eEPGCache::flushEPG(const uniqueEPGKey & s)
 			contentMaps::iterator it =
 				content_time_tables.find(s);
 			if ( it != content_time_tables.end() )
-			{
-				it->second.clear();
 				content_time_tables.erase(it);
-			}
 #endif
 		}
 	}
@@ -768,81 +921,242 @@ void eEPGCache::flushEPG(const uniqueEPGKey & s)
 		content_time_tables.clear();
 #endif
 		channelLastUpdated.clear();
+		m_clean_all = true;
+		m_decoded.clear();
+		m_decoded_index.clear();
+		m_section_fingerprints.clear();
+		m_section_generations.clear();
+		m_section_entries = 0;
+		// the next checkpoint writes a new (empty) snapshot
+		m_dirty.clear();
+		m_have_snapshot = false;
+		{
+			// give the arena back to the system
+			singleLock a(eventData::arena_lock);
+			if (!eventData::arena.chunksInUse())
+				eventData::arena.reset();
+		}
 		singleLock m(channel_map_lock);
 		for (channelMapIterator it(m_knownChannels.begin()); it != m_knownChannels.end(); ++it)
 			it->second->startEPG();
 	}
-	eDebug("[EPGC] %i bytes for cache used", eventData::CacheSize);
+	printMemoryUsage();
 }
 
-void eEPGCache::cleanLoop()
+struct expiredEvent
 {
-	singleLock s(cache_lock);
-	if (!eventDB.empty())
+	time_t now;
+	bool free;
+	expiredEvent(time_t now, bool free)
+		:now(now), free(free)
+	{
+	}
+	template <class T> bool operator()(const T &entry) const
 	{
-		eDebug("[EPGC] start cleanloop");
+		eventData *ev = entry.second;
+		if (now <= ev->getStartTime() + ev->getDuration())
+			return false;
+		if (free)
+			delete ev;
+		return true;
+	}
+};
 
-		time_t now = ::time(0);
+#ifdef ENABLE_PRIVATE_EPG
+// content table entries of events no longer in the timemap
+struct removedEvent
+{
+	timeMap &tmMap;
+	removedEvent(timeMap &tmMap)
+		:tmMap(tmMap)
+	{
+	}
+	bool operator()(time_t start, __u16) const
+	{
+		return tmMap.find(start) == tmMap.end();
+	}
+};
+#endif
 
-		for (eventCache::iterator DBIt = eventDB.begin(); DBIt != eventDB.end(); DBIt++)
-		{
-			bool updated = false;
-			for (timeMap::iterator It = DBIt->second.second.begin(); It != DBIt->second.second.end() && It->first < now;)
-			{
-				if ( now > (It->first+It->second->getDuration()) )  // outdated normal entry (nvod references to)
-				{
-					// remove entry from eventMap
-					eventMap::iterator b(DBIt->second.first.find(It->second->getEventID()));
-					if ( b != DBIt->second.first.end() )
-					{
-						// release Heap Memory for this entry   (new ....)
-//						eDebug("[EPGC] delete old event (evmap)");
-						DBIt->second.first.erase(b);
-					}
+// must be called with cache_lock held
+void eEPGCache::scheduleClean(const uniqueEPGKey &service, timeMap &tmMap)
+{
+	if (tmMap.empty())
+		return;
+	// the service is due when its earliest event ends. broadcasters send
+	// overlapping events too, so the events starting before the first one
+	// ended are checked as well. later events can't end earlier
+	timeMap::iterator it = tmMap.begin();
+	time_t end = it->first + it->second->getDuration();
+	for (++it; it != tmMap.end() && it->first < end; ++it)
+	{
+		time_t e = it->first + it->second->getDuration();
+		if (e < end)
+			end = e;
+	}
+	time_t bucket = end / CLEAN_BUCKET;
+	std::pair<cleanSchedule::iterator, bool> sched =
+		m_clean_scheduled.insert(cleanSchedule::value_type(service, bucket));
+	if (!sched.second)
+	{
+		if (sched.first->second <= bucket)
+			return;
+		sched.first->second = bucket; // the entry in the old bucket is ignored
+	}
+	m_clean_queue[bucket].push_back(service);
+}
 
-					// remove entry from timeMap
-//					eDebug("[EPGC] release heap mem");
-					delete It->second;
-					DBIt->second.second.erase(It++);
-//					eDebug("[EPGC] delete old event (timeMap)");
-					updated = true;
-				}
-				else
-					++It;
-			}
+int eEPGCache::cleanService(eventCache::iterator DBIt, time_t now)
+{
+	// the eventMap references the same events, so it is cleaned first
+	DBIt->second.first.remove_if(expiredEvent(now, false));
+	int removed = DBIt->second.second.remove_if(expiredEvent(now, true));
+	if (!removed)
+		return 0;
+	// outdated events are not journaled, they are removed by the
+	// first cleanloop after load again
+	DBIt->second.first.compact();
+	DBIt->second.second.compact();
 #ifdef ENABLE_PRIVATE_EPG
-			if ( updated )
+	contentMaps::iterator x =
+		content_time_tables.find( DBIt->first );
+	if ( x != content_time_tables.end() )
+	{
+		x->second.remove_if(removedEvent(DBIt->second.second));
+		if ( x->second.empty() )
+			content_time_tables.erase(x);
+	}
+#endif
+	return removed;
+}
+
+// the services are queued by the time their first event ends, so only
+// services with outdated events are visited. at most CLEAN_SLICE services
+// are cleaned with one cache_lock, then the mainloop gets a chance to run
+void eEPGCache::cleanLoop()
+{
+	time_t now = ::time(0);
+	int services = 0, removed = 0;
+	bool more = false;
+	{
+		singleLock s(cache_lock);
+		if (m_clean_all)
+		{
+			m_clean_queue.clear();
+			m_clean_scheduled.clear();
+			for (eventCache::iterator DBIt = eventDB.begin(); DBIt != eventDB.end(); ++DBIt)
+				scheduleClean(DBIt->first, DBIt->second.second);
+			m_clean_all = false;
+		}
+		while (!m_clean_queue.empty() && m_clean_queue.begin()->first < now / CLEAN_BUCKET)
+		{
+			if (services == CLEAN_SLICE)
 			{
-				contentMaps::iterator x =
-					content_time_tables.find( DBIt->first );
-				if ( x != content_time_tables.end() )
-				{
-					timeMap &tmMap = DBIt->second.second;
-					for ( contentMap::iterator i = x->second.begin(); i != x->second.end(); )
-					{
-						for ( contentTimeMap::iterator it(i->second.begin());
-							it != i->second.end(); )
-						{
-							if ( tmMap.find(it->second.first) == tmMap.end() )
-								i->second.erase(it++);
-							else
-								++it;
-						}
-						if ( i->second.size() )
-							++i;
-						else
-							x->second.erase(i++);
-					}
-				}
+				more = true;
+				break;
 			}
-#endif
+			std::map<time_t, std::vector<uniqueEPGKey> >::iterator bucket = m_clean_queue.begin();
+			time_t key = bucket->first;
+			uniqueEPGKey service = bucket->second.back();
+			bucket->second.pop_back();
+			if (bucket->second.empty())
+				m_clean_queue.erase(bucket);
+
+			cleanSchedule::iterator sched = m_clean_scheduled.find(service);
+			if (sched == m_clean_scheduled.end() || sched->second != key)
+				continue; // rescheduled to an earlier bucket
+			m_clean_scheduled.erase(sched);
+			eventCache::iterator DBIt = eventDB.find(service);
+			if (DBIt == eventDB.end())
+				continue;
+			removed += cleanService(DBIt, now);
+			++services;
+			scheduleClean(DBIt->first, DBIt->second.second);
 		}
-		eDebug("[EPGC] stop cleanloop");
-		eDebug("[EPGC] %i bytes for cache used", eventData::CacheSize);
+	}
+	if (removed)
+		eDebug("[EPGC] cleanloop removed %d outdated events of %d services", removed, services);
+	if (more)
+	{
+		cleanTimer->start(CLEAN_SLICE_DELAY, true);
+		return;
+	}
+
+	if (now - m_last_housekeeping >= HOUSEKEEPING_INTERVAL)
+	{
+		m_last_housekeeping = now;
+		singleLock s(cache_lock);
+		eventData::titles.compact();
+		for (__gnu_cxx::hash_map<__u64, sectionFingerprint, hash_sectionKey>::iterator i = m_section_fingerprints.begin(); i != m_section_fingerprints.end(); )
+		{
+			if (now - i->second.time >= SECTION_FINGERPRINT_TIMEOUT)
+				m_section_fingerprints.erase(i++);
+			else
+				++i;
+		}
+		m_section_entries = m_section_fingerprints.size();
+		printMemoryUsage();
 	}
 	cleanTimer->start(CLEAN_INTERVAL,true);
 }
 
+// size of a heap chunk for a malloc(size) with glibc: one size_t header,
+// 2*size_t alignment, 4*size_t minimum
+static inline size_t heapChunk(size_t size)
+{
+	size_t align = 2*sizeof(size_t);
+	size_t chunk = (size + sizeof(size_t) + align - 1) & ~(align - 1);
+	return chunk < 2*align ? 2*align : chunk;
+}
+
+void eEPGCache::printMemoryUsage()
+{
+	singleLock s(cache_lock);
+	size_t events = 0, index = 0, eitdata = 0;
+	for (eventCache::iterator it(eventDB.begin()); it != eventDB.end(); ++it)
+	{
+		events += it->second.second.size();
+		index += it->second.first.memoryUsage() + it->second.second.memoryUsage();
+		for (timeMap::iterator i(it->second.second.begin()); i != it->second.second.end(); ++i)
+			eitdata += i->second->ByteSize;
+	}
+	eDebug("[EPGC] %i bytes for cache used", eventData::CacheSize);
+	if (!events)
+		return;
+
+	size_t arena, mapped;
+	{
+		singleLock a(eventData::arena_lock);
+		arena = eventData::arena.bytesAllocated();
+		mapped = eventData::mapped_size;
+	}
+	size_t per_event = (arena + index) / events;
+
+	// what the same events cost with a heap allocated eventData, a heap
+	// allocated EITdata and a std::map node in eventMap and timeMap each
+	eitdata /= events;
+	size_t rb_node = 4*sizeof(void*); // color, parent, left, right
+	size_t node_based = heapChunk(sizeof(eventData)) + heapChunk(eitdata) +
+		heapChunk(rb_node + sizeof(std::pair<__u16, eventData*>)) +
+		heapChunk(rb_node + sizeof(std::pair<time_t, eventData*>));
+
+	eDebug("[EPGC] %zu events in %zu services, %zu bytes per event (arena %zu bytes, index %zu bytes, mapped %zu bytes), node based maps would need ~%zu bytes per event",
+		events, eventDB.size(), per_event, arena, index, mapped, node_based);
+	eDebug("[EPGC] title search index for %zu titles uses %zu bytes", eventData::titles.titles(), eventData::titles.memoryUsage());
+	eDebug("[EPGC] %d eit section fingerprints, %d unchanged sections skipped, %d decoded", m_section_entries, m_section_hits, m_section_misses);
+	eDebug("[EPGC] %zu decoded events cached, %d hits, %d misses", m_decoded_index.size(), m_decoded_hits, m_decoded_misses);
+#ifdef ENABLE_PRIVATE_EPG
+	size_t entries = 0, content = 0;
+	for (contentMaps::iterator it(content_time_tables.begin()); it != content_time_tables.end(); ++it)
+	{
+		entries += it->second.size();
+		content += it->second.memoryUsage();
+	}
+	if (entries)
+		eDebug("[EPGC] %zu private epg entries in %zu services use %zu bytes", entries, content_time_tables.size(), content);
+#endif
+}
+
 eEPGCache::~eEPGCache()
 {
 	messages.send(Message::quit);
@@ -985,45 +1299,163 @@ void eEPGCache::thread()
 	hasStarted();
 	m_running=1;
 	nice(4);
+	m_writer = new eEPGCacheWriter(this);
+	CONNECT(m_writer->replaced.recv_msg, eEPGCache::snapshotWritten);
+	// decode eit sections in parallel when there is more than one cpu
+	int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus > 1)
+		m_decoder = new eEPGSectionDecoder(this, this, cpus > 4 ? 3 : cpus - 1);
 	load();
 	cleanLoop();
+	checkpointTimer->start(CHECKPOINT_INTERVAL, true);
 	runLoop();
-	save();
+	if (m_decoder)
+	{
+		m_decoder->flush();
+		delete m_decoder;
+		m_decoder = 0;
+	}
+	checkpoint();
+	delete m_writer; // waits until everything is written
+	m_writer = 0;
 	m_running=0;
 }
 
+/*
+ * epg.dat V8. All records have a fixed size and refer to their data by
+ * file offset, so the file is read into one block and used in place
+ * instead of being parsed: the EITdata of the loaded events and their
+ * descriptors stay in the block, only the eventData objects and the
+ * indices are built. The block is an anonymous mapping, not a mapping of
+ * the file, so a removed disk or a changed file can't fault a lookup
+ * days later.
+ *
+ *   epgFileHeader
+ *   epgFileService[service_count]        events of a service are consecutive
+ *   epgFileEvent[event_count]            sorted by start time per service
+ *   epgFileDescriptor[descriptor_count]
+ *   EITdata of all events, 4 byte aligned
+ *   descriptor data
+ *   private epg section: __u32 service_count,
+ *     { uniqueEPGKey, eEPGContentTable }[service_count] (see epgcontent.h)
+ *
+ * Between two snapshots the changes are appended to epg.dat.journal.
+ * Every journal record holds the complete events of the services which
+ * changed since the previous checkpoint (an empty service was removed)
+ * and the descriptors which are not in the snapshot or journal yet:
+ *
+ *   epgJournalHeader                     generation must match the snapshot
+ *   epgJournalRecord, payload            repeated
+ *     __u32 descriptor_count, { __u32 crc, descriptor }[descriptor_count]
+ *     __u32 service_count, { uniqueEPGKey, __u32 event_count,
+ *                            { __u8 type, __u8 len, EITdata }[event_count] }[service_count]
+ */
+struct epgFileHeader
+{
+	unsigned int magic;
+	char version[13];
+	__u8 reserved[3];
+	__u32 file_size;
+	__u32 service_count, event_count, descriptor_count;
+	__u32 service_offset, event_offset, descriptor_offset;
+	__u32 private_offset; // 0 when there is no private epg section
+	__u32 generation; // of the journal belonging to this file
+};
+
+struct epgFileService
+{
+	uniqueEPGKey key;
+	__u32 first_event, event_count;
+};
+
+struct epgFileEvent
+{
+	__u32 data_offset;
+	__u8 type, len;
+	__u16 reserved;
+};
+
+struct epgFileDescriptor
+{
+	__u32 crc;
+	int refcount;
+	__u32 data_offset;
+};
+
+struct epgJournalHeader
+{
+	unsigned int magic;
+	char version[13];
+	__u8 reserved[3];
+	__u32 generation;
+};
+
+struct epgJournalRecord
+{
+	__u32 size; // of the payload
+	__u32 crc; // crc32 of the payload
+};
+
+static std::string journalFilename(const char *filename)
+{
+	return std::string(filename) + ".journal";
+}
+
+struct descriptorCollector
+{
+	std::vector<epgFileDescriptor> records;
+	std::vector<const __u8*> data;
+	bool operator()(__u32 crc, int refcount, const __u8 *descr)
+	{
+		epgFileDescriptor d;
+		d.crc = crc;
+		d.refcount = refcount;
+		d.data_offset = 0;
+		records.push_back(d);
+		data.push_back(descr);
+		return true;
+	}
+};
+
 void eEPGCache::load()
 {
 	FILE *f = fopen(m_filename, "r");
 	if (f)
 	{
-		unlink(m_filename);
 		int size=0;
 		int cnt=0;
 
 		{
 			unsigned int magic=0;
+			char text1[13];
 			fread( &magic, sizeof(int), 1, f);
+			fread( text1, 13, 1, f);
+			// a V8 snapshot is kept, the journal is written against it
+			if (magic != 0x98765432 || strncmp( text1, "ENIGMA_EPG_V8", 13))
+				unlink(m_filename);
 			if (magic != 0x98765432)
 			{
 				eDebug("[EPGC] epg file has incorrect byte order.. dont read it");
 				fclose(f);
 				return;
 			}
-			char text1[13];
-			fread( text1, 13, 1, f);
-			if ( !strncmp( text1, "ENIGMA_EPG_V7", 13) )
+			if ( !strncmp( text1, "ENIGMA_EPG_V8", 13) )
+				loadMapped(f);
+			else if ( !strncmp( text1, "ENIGMA_EPG_V7", 13) )
 			{
 				singleLock s(cache_lock);
 				fread( &size, sizeof(int), 1, f);
 				while(size--)
 				{
 					uniqueEPGKey key;
-					eventMap evMap;
-					timeMap tmMap;
 					int size=0;
 					fread( &key, sizeof(uniqueEPGKey), 1, f);
 					fread( &size, sizeof(int), 1, f);
+					std::pair<eventMap,timeMap> &servicemap = eventDB[key];
+					eventMap &evMap = servicemap.first;
+					timeMap &tmMap = servicemap.second;
+					evMap.reserve(size);
+					tmMap.reserve(size);
 					while(size--)
 					{
 						__u8 len=0;
@@ -1032,165 +1464,664 @@ void eEPGCache::load()
 						fread( &type, sizeof(__u8), 1, f);
 						fread( &len, sizeof(__u8), 1, f);
 						event = new eventData(0, len, type);
-						event->EITdata = new __u8[len];
-						eventData::CacheSize+=len;
+						{
+							singleLock a(eventData::arena_lock);
+							event->EITdata = (__u8*)eventData::arena.alloc(len);
+							eventData::CacheSize+=len;
+						}
 						fread( event->EITdata, len, 1, f);
 						evMap[ event->getEventID() ]=event;
 						tmMap[ event->getStartTime() ]=event;
 						++cnt;
 					}
-					eventDB[key]=std::pair<eventMap,timeMap>(evMap,tmMap);
 				}
 				eventData::load(f);
 				eDebug("[EPGC] %d events read from %s", cnt, m_filename);
+				printMemoryUsage();
 #ifdef ENABLE_PRIVATE_EPG
 				char text2[11];
 				fread( text2, 11, 1, f);
 				if ( !strncmp( text2, "PRIVATE_EPG", 11) )
-				{
-					size=0;
-					fread( &size, sizeof(int), 1, f);
-					while(size--)
-					{
-						int size=0;
-						uniqueEPGKey key;
-						fread( &key, sizeof(uniqueEPGKey), 1, f);
-						eventMap &evMap=eventDB[key].first;
-						fread( &size, sizeof(int), 1, f);
-						while(size--)
-						{
-							int size;
-							int content_id;
-							fread( &content_id, sizeof(int), 1, f);
-							fread( &size, sizeof(int), 1, f);
-							while(size--)
-							{
-								time_t time1, time2;
-								__u16 event_id;
-								fread( &time1, sizeof(time_t), 1, f);
-								fread( &time2, sizeof(time_t), 1, f);
-								fread( &event_id, sizeof(__u16), 1, f);
-								content_time_tables[key][content_id][time1]=std::pair<time_t, __u16>(time2, event_id);
-								eventMap::iterator it =
-									evMap.find(event_id);
-								if (it != evMap.end())
-									it->second->type = PRIVATE;
-							}
-						}
-					}
-				}
+					loadPrivateEPG(f);
+#endif // ENABLE_PRIVATE_EPG
+			}
+			else
+				eDebug("[EPGC] don't read old epg database");
+			fclose(f);
+		}
+	}
+
+	if (m_have_snapshot)
+		replayJournal();
+	else
+		unlink(journalFilename(m_filename).c_str());
+
+	singleLock s(cache_lock);
+	descriptorCollector descr;
+	eventData::descriptors.forEach(descr);
+	m_saved_descriptors.clear();
+	for (size_t i = 0; i < descr.records.size(); ++i)
+		m_saved_descriptors.insert(descr.records[i].crc);
+}
+
+void eEPGCache::loadMapped(FILE *f)
+{
+	struct stat st;
+	if (fstat(fileno(f), &st) < 0 || st.st_size < (off_t)sizeof(epgFileHeader))
+	{
+		eDebug("[EPGC] epg file is too short.. dont read it");
+		return;
+	}
+	size_t file_size = st.st_size;
+	__u8 *map = (__u8*)mmap(0, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+	{
+		eDebug("[EPGC] mmap for epg file failed (%m)");
+		return;
+	}
+	size_t pos = 0;
+	while (pos < file_size)
+	{
+		ssize_t rd = pread(fileno(f), map + pos, file_size - pos, pos);
+		if (rd < 0 && errno == EINTR)
+			continue;
+		if (rd <= 0)
+		{
+			eDebug("[EPGC] read epg file failed (%m)");
+			munmap(map, file_size);
+			return;
+		}
+		pos += rd;
+	}
+	mprotect(map, file_size, PROT_READ);
+
+	// check the complete index before anything is taken from the file
+	const epgFileHeader &hdr = *(const epgFileHeader*)map;
+	const epgFileService *services = (const epgFileService*)(map + hdr.service_offset);
+	const epgFileEvent *events = (const epgFileEvent*)(map + hdr.event_offset);
+	const epgFileDescriptor *descr = (const epgFileDescriptor*)(map + hdr.descriptor_offset);
+	bool valid = hdr.file_size == file_size &&
+		hdr.service_offset + (unsigned long long)hdr.service_count * sizeof(epgFileService) <= file_size &&
+		hdr.event_offset + (unsigned long long)hdr.event_count * sizeof(epgFileEvent) <= file_size &&
+		hdr.descriptor_offset + (unsigned long long)hdr.descriptor_count * sizeof(epgFileDescriptor) <= file_size &&
+		hdr.private_offset <= file_size;
+	for (__u32 i = 0; valid && i < hdr.service_count; ++i)
+		valid = services[i].first_event + (unsigned long long)services[i].event_count <= hdr.event_count;
+	__gnu_cxx::hash_set<__u32> crcs;
+	for (__u32 i = 0; valid && i < hdr.descriptor_count; ++i)
+	{
+		valid = descr[i].data_offset + 2ULL <= file_size &&
+			descr[i].data_offset + 2ULL + map[descr[i].data_offset + 1] <= file_size;
+		crcs.insert(descr[i].crc);
+	}
+	// every descriptor of an event must be in the file, eventData::get
+	// can't handle a missing one
+	for (__u32 i = 0; valid && i < hdr.event_count; ++i)
+	{
+		valid = events[i].len >= 10 && (events[i].len - 10) % 4 == 0 &&
+			events[i].data_offset + (unsigned long long)events[i].len <= file_size;
+		const __u32 *crc = (const __u32*)(map + events[i].data_offset + 10);
+		for (int n = valid ? (events[i].len - 10) / 4 : 0; valid && n; --n, ++crc)
+			valid = crcs.find(*crc) != crcs.end();
+	}
+	if (!valid)
+	{
+		eDebug("[EPGC] epg file is corrupt.. dont read it");
+		munmap(map, file_size);
+		return;
+	}
+
+	singleLock s(cache_lock);
+	{
+		singleLock a(eventData::arena_lock);
+		if (eventData::mapped_data)
+		{
+			eDebug("[EPGC] another epg file is still mapped.. dont read it");
+			munmap(map, file_size);
+			return;
+		}
+		eventData::mapped_data = map;
+		eventData::mapped_size = file_size;
+	}
+
+	int refs = 0, bytes = 0;
+	for (__u32 i = 0; i < hdr.descriptor_count; ++i)
+	{
+		int ret = eventData::descriptors.ref(descr[i].crc, map + descr[i].data_offset, descr[i].refcount, true);
+		if (ret)
+		{
+			bytes += ret;
+			++refs;
+		}
+	}
+	for (__u32 i = 0; i < hdr.service_count; ++i)
+	{
+		std::pair<eventMap,timeMap> &servicemap = eventDB[services[i].key];
+		eventMap &evMap = servicemap.first;
+		timeMap &tmMap = servicemap.second;
+		const epgFileEvent *ev = events + services[i].first_event;
+		evMap.reserve(evMap.size() + services[i].event_count);
+		tmMap.reserve(tmMap.size() + services[i].event_count);
+		for (__u32 n = 0; n < services[i].event_count; ++n, ++ev)
+		{
+			eventData *event = new eventData(0, ev->len, ev->type);
+			event->EITdata = map + ev->data_offset;
+			evMap.push_back(eventMap::value_type(event->getEventID(), event));
+			tmMap.push_back(timeMap::value_type(event->getStartTime(), event));
+			bytes += ev->len;
+		}
+		evMap.sort();
+		tmMap.sort();
+		refs += services[i].event_count;
+	}
+#ifdef ENABLE_PRIVATE_EPG
+	// the content tables are copied, the mapping is released with the last mapped event
+	if (hdr.private_offset && !loadPrivateTables(map + hdr.private_offset, file_size - hdr.private_offset))
+		eDebug("[EPGC] private epg section is corrupt.. dont read it");
+#endif
+	{
+		singleLock a(eventData::arena_lock);
+		eventData::mapped_refs += refs;
+		eventData::CacheSize += bytes;
+		if (!refs)
+			eventData::releaseMapped(0);
+	}
+	m_generation = m_snapshot_generation = hdr.generation;
+	m_have_snapshot = true;
+	eDebug("[EPGC] %u events mapped from %s", hdr.event_count, m_filename);
+	printMemoryUsage();
+}
+
+#ifdef ENABLE_PRIVATE_EPG
+void eEPGCache::loadPrivateEPG(FILE *f)
+{
+	singleLock s(cache_lock);
+	int size=0;
+	fread( &size, sizeof(int), 1, f);
+	while(size--)
+	{
+		int size=0;
+		uniqueEPGKey key;
+		fread( &key, sizeof(uniqueEPGKey), 1, f);
+		eventMap &evMap=eventDB[key].first;
+		fread( &size, sizeof(int), 1, f);
+		while(size--)
+		{
+			int size;
+			int content_id;
+			std::vector<eEPGContentTable::entry> entries;
+			fread( &content_id, sizeof(int), 1, f);
+			fread( &size, sizeof(int), 1, f);
+			while(size--)
+			{
+				time_t time1, time2;
+				__u16 event_id;
+				fread( &time1, sizeof(time_t), 1, f);
+				fread( &time2, sizeof(time_t), 1, f);
+				fread( &event_id, sizeof(__u16), 1, f);
+				entries.push_back(eEPGContentTable::entry(time1, time2, event_id));
+				eventMap::iterator it =
+					evMap.find(event_id);
+				if (it != evMap.end())
+					it->second->type = PRIVATE;
+			}
+			content_time_tables[key].replace(content_id, entries);
+		}
+	}
+}
+
+// the private epg section of a V8 snapshot
+bool eEPGCache::loadPrivateTables(const __u8 *data, size_t len)
+{
+	singleLock s(cache_lock);
+	__u32 size;
+	if (len < sizeof(__u32))
+		return false;
+	memcpy(&size, data, sizeof(__u32));
+	size_t pos = sizeof(__u32);
+	while (size--)
+	{
+		uniqueEPGKey key;
+		if (len - pos < sizeof(uniqueEPGKey))
+			return false;
+		memcpy(&key, data + pos, sizeof(uniqueEPGKey));
+		pos += sizeof(uniqueEPGKey);
+		eEPGContentTable &table = content_time_tables[key];
+		int ret = table.deserialize(data + pos, len - pos);
+		if (ret < 0)
+		{
+			content_time_tables.erase(key);
+			return false;
+		}
+		pos += ret;
+	}
+	return true;
+}
 #endif // ENABLE_PRIVATE_EPG
+
+static const __u8 padding[4] = { 0, 0, 0, 0 };
+
+static inline void put(std::vector<__u8> &data, const void *p, size_t len)
+{
+	data.insert(data.end(), (const __u8*)p, (const __u8*)p + len);
+}
+
+void eEPGCache::buildSnapshot(std::vector<__u8> &data, __u32 generation)
+{
+	// the refcounts of the store also count parsed events which are not in
+	// the cache (yet), so they are counted again over the saved events
+	std::map<__u32, int> refcount;
+	for (eventCache::iterator service_it(eventDB.begin()); service_it != eventDB.end(); ++service_it)
+	{
+		timeMap &timemap = service_it->second.second;
+		for (timeMap::iterator time_it(timemap.begin()); time_it != timemap.end(); ++time_it)
+		{
+			__u32 *crc = (__u32*)(time_it->second->EITdata+10);
+			for (int n = (time_it->second->ByteSize-10)/4; n; --n, ++crc)
+				++refcount[*crc];
+		}
+	}
+	descriptorCollector descr;
+	for (std::map<__u32, int>::iterator it(refcount.begin()); it != refcount.end(); ++it)
+	{
+		const __u8 *d = eventData::descriptors.lookup(it->first);
+		if (!d)
+			eFatal("LINE %d descriptor not found in descriptor cache %08x!!!!!!", __LINE__, it->first);
+		descr(it->first, it->second, d);
+	}
+
+	epgFileHeader hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = 0x98765432;
+	memcpy(hdr.version, "ENIGMA_EPG_V8", 13);
+	hdr.generation = generation;
+	hdr.service_count = eventDB.size();
+	for (eventCache::iterator service_it(eventDB.begin()); service_it != eventDB.end(); ++service_it)
+		hdr.event_count += service_it->second.second.size();
+	hdr.descriptor_count = descr.records.size();
+	hdr.service_offset = sizeof(epgFileHeader);
+	hdr.event_offset = hdr.service_offset + hdr.service_count * sizeof(epgFileService);
+	hdr.descriptor_offset = hdr.event_offset + hdr.event_count * sizeof(epgFileEvent);
+	__u32 offset = hdr.descriptor_offset + hdr.descriptor_count * sizeof(epgFileDescriptor);
+	data.reserve(offset + eventData::CacheSize + 3 * hdr.event_count + 4096);
+	put(data, &hdr, sizeof(epgFileHeader)); // completed at the end
+
+	__u32 first = 0;
+	for (eventCache::iterator service_it(eventDB.begin()); service_it != eventDB.end(); ++service_it)
+	{
+		epgFileService service;
+		service.key = service_it->first;
+		service.first_event = first;
+		service.event_count = service_it->second.second.size();
+		first += service.event_count;
+		put(data, &service, sizeof(epgFileService));
+	}
+
+	for (eventCache::iterator service_it(eventDB.begin()); service_it != eventDB.end(); ++service_it)
+	{
+		timeMap &timemap = service_it->second.second;
+		for (timeMap::iterator time_it(timemap.begin()); time_it != timemap.end(); ++time_it)
+		{
+			epgFileEvent event;
+			event.data_offset = offset;
+			event.type = time_it->second->type;
+			event.len = time_it->second->ByteSize;
+			event.reserved = 0;
+			offset += (event.len + 3) & ~3;
+			put(data, &event, sizeof(epgFileEvent));
+		}
+	}
+
+	m_saved_descriptors.clear();
+	for (size_t i = 0; i < descr.records.size(); ++i)
+	{
+		descr.records[i].data_offset = offset;
+		offset += descr.data[i][1] + 2;
+		put(data, &descr.records[i], sizeof(epgFileDescriptor));
+		m_saved_descriptors.insert(descr.records[i].crc);
+	}
+
+	for (eventCache::iterator service_it(eventDB.begin()); service_it != eventDB.end(); ++service_it)
+	{
+		timeMap &timemap = service_it->second.second;
+		for (timeMap::iterator time_it(timemap.begin()); time_it != timemap.end(); ++time_it)
+		{
+			int len = time_it->second->ByteSize;
+			put(data, time_it->second->EITdata, len);
+			if (len & 3)
+				put(data, padding, 4 - (len & 3));
+		}
+	}
+
+	for (size_t i = 0; i < descr.data.size(); ++i)
+		put(data, descr.data[i], descr.data[i][1] + 2);
+
+#ifdef ENABLE_PRIVATE_EPG
+	hdr.private_offset = offset;
+	__u32 size = content_time_tables.size();
+	put(data, &size, sizeof(__u32));
+	for (contentMaps::iterator a = content_time_tables.begin(); a != content_time_tables.end(); ++a)
+	{
+		put(data, &a->first, sizeof(uniqueEPGKey));
+		a->second.serialize(data);
+	}
+#endif
+	hdr.file_size = data.size();
+	memcpy(&data[0], &hdr, sizeof(epgFileHeader));
+}
+
+void eEPGCache::save()
+{
+	// check for enough free space on storage
+	char dir[1024];
+	strcpy(dir, m_filename);
+	char *slash = strrchr(dir, '/');
+	if (slash)
+		slash[slash == dir ? 1 : 0] = 0;
+	else
+		strcpy(dir, ".");
+
+	struct statfs s;
+	off64_t tmp;
+	if (statfs(dir, &s) < 0) {
+		eDebug("[EPGC] statfs '%s' failed in save (%m)", dir);
+		return;
+	}
+
+	tmp=s.f_bfree;
+	tmp*=s.f_bsize;
+	if ( tmp < (eventData::CacheSize*12)/10 ) // 20% overhead
+	{
+		eDebug("[EPGC] not enough free space at path '%s' %lld bytes availd but %d needed", dir, tmp, (eventData::CacheSize*12)/10);
+		return;
+	}
+
+	std::vector<__u8> *data = new std::vector<__u8>;
+	int events;
+	__u32 generation = ++m_snapshot_generation;
+	{
+		singleLock l(cache_lock);
+		buildSnapshot(*data, generation);
+		events = ((epgFileHeader*)&(*data)[0])->event_count;
+		m_dirty.clear();
+	}
+	++m_pending_snapshots;
+	eDebug("[EPGC] store %d events to '%s'", events, m_filename);
+	m_writer->replace(m_filename, data, generation);
+}
+
+void eEPGCache::snapshotWritten(const eEPGCacheWriter::Result &result)
+{
+	--m_pending_snapshots;
+	if (!result.error)
+		m_generation = result.id;
+	else
+		eDebug("[EPGC] snapshot %d not stored", result.id);
+	if (!m_pending_snapshots)
+	{
+		// a journal only continues the newest snapshot, when it failed
+		// the next checkpoint writes a complete one again
+		m_have_snapshot = m_generation == m_snapshot_generation;
+		m_journal_size = 0;
+	}
+}
+
+void eEPGCache::buildJournal(std::vector<__u8> &data)
+{
+	if (!m_journal_size)
+	{
+		epgJournalHeader hdr;
+		memset(&hdr, 0, sizeof(hdr));
+		hdr.magic = 0x98765432;
+		memcpy(hdr.version, "ENIGMA_EPG_J8", 13);
+		hdr.generation = m_generation;
+		put(data, &hdr, sizeof(epgJournalHeader));
+	}
+	size_t record = data.size();
+	epgJournalRecord rec;
+	put(data, &rec, sizeof(epgJournalRecord)); // completed at the end
+
+	std::vector<__u8> services;
+	__u32 descriptor_count = 0;
+	size_t descriptors = data.size();
+	put(data, &descriptor_count, sizeof(__u32));
+	__u32 service_count = m_dirty.size();
+	put(services, &service_count, sizeof(__u32));
+	for (std::set<uniqueEPGKey>::iterator it(m_dirty.begin()); it != m_dirty.end(); ++it)
+	{
+		eventCache::iterator service_it = eventDB.find(*it);
+		__u32 count = service_it != eventDB.end() ? service_it->second.second.size() : 0;
+		put(services, &*it, sizeof(uniqueEPGKey));
+		put(services, &count, sizeof(__u32));
+		if (!count)
+			continue;
+		timeMap &timemap = service_it->second.second;
+		for (timeMap::iterator time_it(timemap.begin()); time_it != timemap.end(); ++time_it)
+		{
+			eventData *event = time_it->second;
+			put(services, &event->type, sizeof(__u8));
+			put(services, &event->ByteSize, sizeof(__u8));
+			put(services, event->EITdata, event->ByteSize);
+			// descriptors which are neither in the snapshot nor in the journal yet
+			__u32 *crc = (__u32*)(event->EITdata+10);
+			for (int n = (event->ByteSize-10)/4; n; --n, ++crc)
+			{
+				if (!m_saved_descriptors.insert(*crc).second)
+					continue;
+				const __u8 *descr = eventData::descriptors.lookup(*crc);
+				put(data, crc, sizeof(__u32));
+				put(data, descr, descr[1]+2);
+				++descriptor_count;
 			}
-			else
-				eDebug("[EPGC] don't read old epg database");
-			fclose(f);
 		}
 	}
+	memcpy(&data[descriptors], &descriptor_count, sizeof(__u32));
+	data.insert(data.end(), services.begin(), services.end());
+
+	rec.size = data.size() - record - sizeof(epgJournalRecord);
+	rec.crc = crc32(0, &data[record + sizeof(epgJournalRecord)], rec.size);
+	memcpy(&data[record], &rec, sizeof(epgJournalRecord));
 }
 
-void eEPGCache::save()
+void eEPGCache::replayJournal()
 {
-	/* create empty file */
-	FILE *f = fopen(m_filename, "w");
-
+	std::string filename = journalFilename(m_filename);
+	FILE *f = fopen(filename.c_str(), "r");
 	if (!f)
-	{
-		eDebug("[EPGC] couldn't save epg data to '%s'(%m)", m_filename);
 		return;
-	}
+	std::vector<__u8> journal;
+	__u8 buf[16384];
+	size_t rd;
+	while ((rd = fread(buf, 1, sizeof(buf), f)) > 0)
+		journal.insert(journal.end(), buf, buf + rd);
+	fclose(f);
 
-	char *buf = realpath(m_filename, NULL);
-	if (!buf)
+	epgJournalHeader hdr;
+	if (journal.size() < sizeof(epgJournalHeader))
+		memset(&hdr, 0, sizeof(hdr));
+	else
+		memcpy(&hdr, &journal[0], sizeof(epgJournalHeader));
+	if (hdr.magic != 0x98765432 || strncmp(hdr.version, "ENIGMA_EPG_J8", 13) || hdr.generation != m_generation)
 	{
-		eDebug("[EPGC] realpath to '%s' failed in save (%m)", m_filename);
-		fclose(f);
+		eDebug("[EPGC] journal %s does not belong to the epg file.. dont replay it", filename.c_str());
+		unlink(filename.c_str());
 		return;
 	}
 
-	eDebug("[EPGC] store epg to realpath '%s'", buf);
+	singleLock s(cache_lock);
+	// replaced events are deleted at the end, so descriptors which are only
+	// saved with them stay known for the following records
+	std::vector<eventData*> obsolete;
+	size_t pos = sizeof(epgJournalHeader);
+	int records = 0, cnt = 0;
+	while (pos + sizeof(epgJournalRecord) <= journal.size())
+	{
+		epgJournalRecord rec;
+		memcpy(&rec, &journal[pos], sizeof(epgJournalRecord));
+		const __u8 *p = &journal[pos + sizeof(epgJournalRecord)];
+		if (rec.size > journal.size() - pos - sizeof(epgJournalRecord) || crc32(0, p, rec.size) != rec.crc)
+			break;
+		pos += sizeof(epgJournalRecord) + rec.size;
+		++records;
+
+		__gnu_cxx::hash_map<__u32, const __u8*> descr;
+		__u32 count;
+		memcpy(&count, p, sizeof(__u32));
+		p += sizeof(__u32);
+		while (count--)
+		{
+			__u32 crc;
+			memcpy(&crc, p, sizeof(__u32));
+			p += sizeof(__u32);
+			descr[crc] = p;
+			p += p[1] + 2;
+		}
 
-	struct statfs s;
-	off64_t tmp;
-	if (statfs(buf, &s) < 0) {
-		eDebug("[EPGC] statfs '%s' failed in save (%m)", buf);
-		fclose(f);
-		return;
-	}
+		memcpy(&count, p, sizeof(__u32));
+		p += sizeof(__u32);
+		while (count--)
+		{
+			uniqueEPGKey key;
+			__u32 events;
+			memcpy(&key, p, sizeof(uniqueEPGKey));
+			p += sizeof(uniqueEPGKey);
+			memcpy(&events, p, sizeof(__u32));
+			p += sizeof(__u32);
+
+			eventCache::iterator it = eventDB.find(key);
+			if (it != eventDB.end())
+			{
+				for (eventMap::iterator i = it->second.first.begin(); i != it->second.first.end(); ++i)
+					obsolete.push_back(i->second);
+				if (!events)
+				{
+					eventDB.erase(it);
+					continue;
+				}
+				it->second.first.clear();
+				it->second.second.clear();
+			}
+			else if (!events)
+				continue;
 
-	free(buf);
+			std::pair<eventMap,timeMap> &servicemap = eventDB[key];
+			servicemap.first.reserve(events);
+			servicemap.second.reserve(events);
+			while (events--)
+			{
+				__u8 type = *p++;
+				__u8 len = *p++;
+				const __u8 *eitdata = p;
+				p += len;
+
+				const __u8 *d[65];
+				int n = (len-10)/4;
+				bool valid = len >= 10 && n <= 65;
+				for (int i = 0; valid && i < n; ++i)
+				{
+					__u32 crc;
+					memcpy(&crc, eitdata + 10 + i * 4, sizeof(__u32));
+					d[i] = eventData::descriptors.lookup(crc);
+					if (!d[i])
+					{
+						__gnu_cxx::hash_map<__u32, const __u8*>::iterator x = descr.find(crc);
+						if (x != descr.end())
+							d[i] = x->second;
+						else
+							valid = false;
+					}
+				}
+				if (!valid)
+				{
+					eDebug("[EPGC] journal event with unknown descriptor.. skip it");
+					continue;
+				}
 
-	// check for enough free space on storage
-	tmp=s.f_bfree;
-	tmp*=s.f_bsize;
-	if ( tmp < (eventData::CacheSize*12)/10 ) // 20% overhead
+				eventData *event = new eventData(0, len, type);
+				int bytes = len;
+				for (int i = 0; i < n; ++i)
+				{
+					__u32 crc;
+					memcpy(&crc, eitdata + 10 + i * 4, sizeof(__u32));
+					bytes += eventData::descriptors.ref(crc, d[i]);
+				}
+				{
+					singleLock a(eventData::arena_lock);
+					event->EITdata = (__u8*)eventData::arena.alloc(len);
+					eventData::CacheSize+=bytes;
+				}
+				memcpy(event->EITdata, eitdata, len);
+				servicemap.first.push_back(eventMap::value_type(event->getEventID(), event));
+				servicemap.second.push_back(timeMap::value_type(event->getStartTime(), event));
+				++cnt;
+			}
+			servicemap.first.sort();
+			servicemap.second.sort();
+		}
+	}
+
+	if (pos != journal.size())
 	{
-		eDebug("[EPGC] not enough free space at path '%s' %lld bytes availd but %d needed", buf, tmp, (eventData::CacheSize*12)/10);
-		fclose(f);
-		return;
+		// appending behind a broken record would be lost, write a new snapshot
+		eDebug("[EPGC] journal %s is broken after %d records", filename.c_str(), records);
+		m_have_snapshot = false;
 	}
+	m_journal_size = journal.size();
 
-	int cnt=0;
-	unsigned int magic = 0x98765432;
-	fwrite( &magic, sizeof(int), 1, f);
-	const char *text = "UNFINISHED_V7";
-	fwrite( text, 13, 1, f );
-	int size = eventDB.size();
-	fwrite( &size, sizeof(int), 1, f );
-	for (eventCache::iterator service_it(eventDB.begin()); service_it != eventDB.end(); ++service_it)
+	for (std::vector<eventData*>::iterator it(obsolete.begin()); it != obsolete.end(); ++it)
+		delete *it;
+	eDebug("[EPGC] %d events from %d journal records replayed", cnt, records);
+}
+
+void eEPGCache::checkpoint()
+{
+	if (!m_writer || !strlen(m_filename))
+		return;
+
+	if (m_pending_snapshots)
 	{
-		timeMap &timemap = service_it->second.second;
-		fwrite( &service_it->first, sizeof(uniqueEPGKey), 1, f);
-		size = timemap.size();
-		fwrite( &size, sizeof(int), 1, f);
-		for (timeMap::iterator time_it(timemap.begin()); time_it != timemap.end(); ++time_it)
+		// the journal can't follow a snapshot that is not on disk yet,
+		// changes since then go into another snapshot
+		bool dirty;
 		{
-			__u8 len = time_it->second->ByteSize;
-			fwrite( &time_it->second->type, sizeof(__u8), 1, f );
-			fwrite( &len, sizeof(__u8), 1, f);
-			fwrite( time_it->second->EITdata, len, 1, f);
-			++cnt;
+			singleLock s(cache_lock);
+			dirty = !m_dirty.empty();
 		}
+		if (dirty)
+			save();
 	}
-	eDebug("[EPGC] %d events written to %s", cnt, m_filename);
-	eventData::save(f);
-#ifdef ENABLE_PRIVATE_EPG
-	const char* text3 = "PRIVATE_EPG";
-	fwrite( text3, 11, 1, f );
-	size = content_time_tables.size();
-	fwrite( &size, sizeof(int), 1, f);
-	for (contentMaps::iterator a = content_time_tables.begin(); a != content_time_tables.end(); ++a)
+	// write a new snapshot when the journal grows bigger than half of the cache
+	else if (!m_have_snapshot || m_journal_size > (size_t)eventData::CacheSize / 2 + 64*1024)
+		save();
+	else
 	{
-		contentMap &content_time_table = a->second;
-		fwrite( &a->first, sizeof(uniqueEPGKey), 1, f);
-		int size = content_time_table.size();
-		fwrite( &size, sizeof(int), 1, f);
-		for (contentMap::iterator i = content_time_table.begin(); i != content_time_table.end(); ++i )
-		{
-			int size = i->second.size();
-			fwrite( &i->first, sizeof(int), 1, f);
-			fwrite( &size, sizeof(int), 1, f);
-			for ( contentTimeMap::iterator it(i->second.begin());
-				it != i->second.end(); ++it )
-			{
-				fwrite( &it->first, sizeof(time_t), 1, f);
-				fwrite( &it->second.first, sizeof(time_t), 1, f);
-				fwrite( &it->second.second, sizeof(__u16), 1, f);
-			}
+		std::vector<__u8> *data = new std::vector<__u8>;
+		{
+			singleLock s(cache_lock);
+			if (!m_dirty.empty())
+				buildJournal(*data);
+			m_dirty.clear();
+		}
+		if (data->empty())
+			delete data;
+		else
+		{
+			std::string filename = journalFilename(m_filename);
+			eDebug("[EPGC] append %zu bytes to %s", data->size(), filename.c_str());
+			if (m_journal_size)
+				m_writer->append(filename.c_str(), data);
+			else
+				m_writer->create(filename.c_str(), data);
+			m_journal_size += data->size();
 		}
 	}
-#endif
-	// write version string after binary data
-	// has been written to disk.
-	fsync(fileno(f));
-	fseek(f, sizeof(int), SEEK_SET);
-	fwrite("ENIGMA_EPG_V7", 13, 1, f);
-	fclose(f);
+	checkpointTimer->start(CHECKPOINT_INTERVAL, true);
 }
 
 eEPGCache::channel_data::channel_data(eEPGCache *ml)
 	:cache(ml)
 	,abortTimer(eTimer::create(ml)), zapTimer(eTimer::create(ml)), state(-2)
-	,isRunning(0), haveData(0)
+	,isRunning(0), haveData(0), crcErrors(0)
 #ifdef ENABLE_PRIVATE_EPG
 	,startPrivateTimer(eTimer::create(ml))
 #endif
@@ -1269,7 +2200,9 @@ void eEPGCache::channel_data::startEPG()
 #endif
 
 	mask.pid = 0x12;
-	mask.flags = eDVBSectionFilterMask::rfCRC;
+	// the software crc check is done by readData, before a section is
+	// counted as seen
+	mask.flags = eDVBSectionFilterMask::rfCRC | eDVBSectionFilterMask::rfDeferCRC;
 
 	mask.data[0] = 0x4E;
 	mask.mask[0] = 0xFE;
@@ -1289,6 +2222,8 @@ void eEPGCache::channel_data::startEPG()
 	isRunning |= SCHEDULE_OTHER;
 
 	mask.pid = 0x39;
+	// readDataViasat changes the table id, so the crc is checked by the reader
+	mask.flags = eDVBSectionFilterMask::rfCRC;
 
 	mask.data[0] = 0x40;
 	mask.mask[0] = 0x40;
@@ -1473,6 +2408,14 @@ void eEPGCache::channel_data::readData( const __u8 *data)
 			eDebug("[EPGC] unknown table_id !!!");
 			return;
 	}
+	// the reader checked the crc of the viasat sections, their table id
+	// was changed since
+	if (source != VIASAT && crc32((unsigned)-1, data, (((data[1] & 0x0F) << 8) | data[2]) + 3))
+	{
+		if (!(crcErrors++ % 100))
+			eDebug("[EPGC] %d eit sections with crc errors", crcErrors);
+		return;
+	}
 	tidMap &seenSections = this->seenSections[map];
 	tidMap &calcedSections = this->calcedSections[map];
 	if ( (state == 1 && calcedSections == seenSections) || state > 1 )
@@ -1532,7 +2475,7 @@ void eEPGCache::channel_data::readData( const __u8 *data)
 				else
 					calcedSections.insert(tmpval|(i&0xFF));
 			}
-			cache->sectionRead(data, source, this);
+			cache->queueSection(data, source, this);
 		}
 	}
 }
@@ -1555,10 +2498,9 @@ RESULT eEPGCache::lookupEventTime(const eServiceReference &service, time_t t, co
 		{
 			if ( direction < 0 || (direction == 0 && i->first > t) )
 			{
-				timeMap::iterator x = i;
-				--x;
-				if ( x != It->second.second.end() )
+				if ( i != It->second.second.begin() )
 				{
+					timeMap::iterator x = i - 1;
 					time_t start_time = x->first;
 					if (direction >= 0)
 					{
@@ -1599,6 +2541,72 @@ RESULT eEPGCache::lookupEventTime(const eServiceReference &service, time_t t, Ev
 	return ret;
 }
 
+__u64 eEPGCache::decodedKey(const uniqueEPGKey &service, __u16 event_id)
+{
+	return ((__u64)(service.sid & 0xFFFF) << 48) | ((__u64)(service.onid & 0xFFFF) << 32) |
+		((__u64)(service.tsid & 0xFFFF) << 16) | event_id;
+}
+
+// must be called with cache_lock held
+RESULT eEPGCache::decodeEvent(const uniqueEPGKey &service, const eventData *data, int tsidonid, ePtr<eServiceEvent> &result)
+{
+	if (m_decoded_language != eServiceEvent::getEPGLanguage())
+	{
+		m_decoded.clear();
+		m_decoded_index.clear();
+		m_decoded_language = eServiceEvent::getEPGLanguage();
+	}
+
+	__u64 key = decodedKey(service, (data->EITdata[0] << 8) | data->EITdata[1]);
+	__gnu_cxx::hash_map<__u64, std::list<decodedEvent>::iterator, hash_sectionKey>::iterator it = m_decoded_index.find(key);
+	if (it != m_decoded_index.end())
+	{
+		decodedEvent &d = *it->second;
+		if (d.tsidonid == tsidonid && d.eit.size() == data->ByteSize && !memcmp(d.eit.data(), data->EITdata, data->ByteSize))
+		{
+			++m_decoded_hits;
+			m_decoded.splice(m_decoded.begin(), m_decoded, it->second);
+			result = d.event;
+			return 0;
+		}
+		m_decoded.erase(it->second);
+		m_decoded_index.erase(it);
+	}
+
+	++m_decoded_misses;
+	Event ev((uint8_t*)data->get());
+	ePtr<eServiceEvent> evt = new eServiceEvent();
+	RESULT ret = evt->parseFrom(&ev, tsidonid);
+	result = evt;
+	if (ret)
+		return ret;
+
+	m_decoded.push_front(decodedEvent());
+	decodedEvent &d = m_decoded.front();
+	d.key = key;
+	d.tsidonid = tsidonid;
+	d.eit.assign((const char*)data->EITdata, data->ByteSize);
+	d.event = evt;
+	m_decoded_index[key] = m_decoded.begin();
+	if (m_decoded_index.size() > DECODED_EVENTS)
+	{
+		m_decoded_index.erase(m_decoded.back().key);
+		m_decoded.pop_back();
+	}
+	return 0;
+}
+
+// must be called with cache_lock held
+void eEPGCache::invalidateDecoded(const uniqueEPGKey &service, __u16 event_id)
+{
+	__gnu_cxx::hash_map<__u64, std::list<decodedEvent>::iterator, hash_sectionKey>::iterator it = m_decoded_index.find(decodedKey(service, event_id));
+	if (it != m_decoded_index.end())
+	{
+		m_decoded.erase(it->second);
+		m_decoded_index.erase(it);
+	}
+}
+
 RESULT eEPGCache::lookupEventTime(const eServiceReference &service, time_t t, ePtr<eServiceEvent> &result, int direction)
 {
 	singleLock s(cache_lock);
@@ -1606,10 +2614,8 @@ RESULT eEPGCache::lookupEventTime(const eServiceReference &service, time_t t, eP
 	RESULT ret = lookupEventTime(service, t, data, direction);
 	if ( !ret && data )
 	{
-		Event ev((uint8_t*)data->get());
-		result = new eServiceEvent();
 		const eServiceReferenceDVB &ref = (const eServiceReferenceDVB&)service;
-		ret = result->parseFrom(&ev, (ref.getTransportStreamID().get()<<16)|ref.getOriginalNetworkID().get());
+		ret = decodeEvent(uniqueEPGKey(handleGroup(service)), data, (ref.getTransportStreamID().get()<<16)|ref.getOriginalNetworkID().get(), result);
 	}
 	return ret;
 }
@@ -1664,10 +2670,8 @@ RESULT eEPGCache::lookupEventId(const eServiceReference &service, int event_id,
 	RESULT ret = lookupEventId(service, event_id, data);
 	if ( !ret && data )
 	{
-		Event ev((uint8_t*)data->get());
-		result = new eServiceEvent();
 		const eServiceReferenceDVB &ref = (const eServiceReferenceDVB&)service;
-		ret = result->parseFrom(&ev, (ref.getTransportStreamID().get()<<16)|ref.getOriginalNetworkID().get());
+		ret = decodeEvent(uniqueEPGKey(handleGroup(service)), data, (ref.getTransportStreamID().get()<<16)|ref.getOriginalNetworkID().get(), result);
 	}
 	return ret;
 }
@@ -1681,72 +2685,77 @@ RESULT eEPGCache::startTimeQuery(const eServiceReference &service, time_t begin,
 	eventCache::iterator It = eventDB.find(ref);
 	if ( It != eventDB.end() && It->second.second.size() )
 	{
-		m_timemap_cursor = It->second.second.lower_bound(begin);
-		if ( m_timemap_cursor != It->second.second.end() )
+		timeMap &tmMap = It->second.second;
+		timeMap::iterator cursor = tmMap.lower_bound(begin);
+		if ( cursor != tmMap.end() && cursor->first != begin && cursor != tmMap.begin() )
 		{
-			if ( m_timemap_cursor->first != begin )
-			{
-				timeMap::iterator x = m_timemap_cursor;
-				--x;
-				if ( x != It->second.second.end() )
-				{
-					time_t start_time = x->first;
-					if ( begin > start_time && begin < (start_time+x->second->getDuration()))
-						m_timemap_cursor = x;
-				}
-			}
+			timeMap::iterator x = cursor - 1;
+			time_t start_time = x->first;
+			if ( begin > start_time && begin < (start_time+x->second->getDuration()))
+				cursor = x;
 		}
 
-		if (minutes != -1)
-			m_timemap_end = It->second.second.lower_bound(begin+minutes*60);
-		else
-			m_timemap_end = It->second.second.end();
+		m_timemap_service = It->first;
+		m_timemap_cursor = cursor != tmMap.end() ? cursor->first : begin;
+		m_timemap_end = minutes != -1 ? begin+minutes*60 : -1;
 
 		currentQueryTsidOnid = (ref.getTransportStreamID().get()<<16) | ref.getOriginalNetworkID().get();
-		return m_timemap_cursor == m_timemap_end ? -1 : 0;
+		if ( cursor == tmMap.end() || (m_timemap_end != -1 && cursor->first >= m_timemap_end) )
+			return -1;
+		return 0;
 	}
+	m_timemap_service = uniqueEPGKey();
 	return -1;
 }
 
 RESULT eEPGCache::getNextTimeEntry(const eventData *& result)
 {
-	if ( m_timemap_cursor != m_timemap_end )
-	{
-		result = m_timemap_cursor++->second;
-		return 0;
-	}
-	return -1;
+	singleLock s(cache_lock);
+	if ( !m_timemap_service )
+		return -1;
+	eventCache::iterator It = eventDB.find(m_timemap_service);
+	if ( It == eventDB.end() )
+		return -1;
+	timeMap::iterator i = It->second.second.lower_bound(m_timemap_cursor);
+	if ( i == It->second.second.end() || (m_timemap_end != -1 && i->first >= m_timemap_end) )
+		return -1;
+	result = i->second;
+	m_timemap_cursor = i->first + 1;
+	return 0;
 }
 
 RESULT eEPGCache::getNextTimeEntry(const eit_event_struct *&result)
 {
-	if ( m_timemap_cursor != m_timemap_end )
-	{
-		result = m_timemap_cursor++->second->get();
-		return 0;
-	}
-	return -1;
+	singleLock s(cache_lock);
+	const eventData *data=0;
+	RESULT ret = getNextTimeEntry(data);
+	if ( !ret && data )
+		result = data->get();
+	return ret;
 }
 
 RESULT eEPGCache::getNextTimeEntry(Event *&result)
 {
-	if ( m_timemap_cursor != m_timemap_end )
-	{
-		result = new Event((uint8_t*)m_timemap_cursor++->second->get());
-		return 0;
-	}
-	return -1;
+	singleLock s(cache_lock);
+	const eventData *data=0;
+	RESULT ret = getNextTimeEntry(data);
+	if ( !ret && data )
+		result = new Event((uint8_t*)data->get());
+	return ret;
 }
 
 RESULT eEPGCache::getNextTimeEntry(ePtr<eServiceEvent> &result)
 {
-	if ( m_timemap_cursor != m_timemap_end )
+	singleLock s(cache_lock);
+	const eventData *data=0;
+	RESULT ret = getNextTimeEntry(data);
+	if ( !ret && data )
 	{
-		Event ev((uint8_t*)m_timemap_cursor++->second->get());
+		Event ev((uint8_t*)data->get());
 		result = new eServiceEvent();
-		return result->parseFrom(&ev, currentQueryTsidOnid);
+		ret = result->parseFrom(&ev, currentQueryTsidOnid);
 	}
-	return -1;
+	return ret;
 }
 
 void fillTuple(ePyObject tuple, const char *argstring, int argcount, ePyObject service, eServiceEvent *ptr, ePyObject nowTime, ePyObject service_name )
@@ -2043,9 +3052,10 @@ PyObject *eEPGCache::lookupEvent(ePyObject list, ePyObject convertFunc)
 				singleLock s(cache_lock);
 				if (!startTimeQuery(ref, stime, minutes))
 				{
-					while ( m_timemap_cursor != m_timemap_end )
+					const eventData *ev_data=0;
+					while ( !getNextTimeEntry(ev_data) )
 					{
-						Event ev((uint8_t*)m_timemap_cursor++->second->get());
+						Event ev((uint8_t*)ev_data->get());
 						eServiceEvent evt;
 						evt.parseFrom(&ev, currentQueryTsidOnid);
 						if (handleEvent(&evt, dest_list, argstring, argcount, service, nowTime, service_name, convertFunc, convertFuncArgs))
@@ -2057,7 +3067,7 @@ PyObject *eEPGCache::lookupEvent(ePyObject list, ePyObject convertFunc)
 			}
 			else
 			{
-				eServiceEvent evt;
+				ePtr<eServiceEvent> evt;
 				const eventData *ev_data=0;
 				if (stime)
 				{
@@ -2069,13 +3079,12 @@ PyObject *eEPGCache::lookupEvent(ePyObject list, ePyObject convertFunc)
 					if (ev_data)
 					{
 						const eServiceReferenceDVB &dref = (const eServiceReferenceDVB&)ref;
-						Event ev((uint8_t*)ev_data->get());
-						evt.parseFrom(&ev, (dref.getTransportStreamID().get()<<16)|dref.getOriginalNetworkID().get());
+						decodeEvent(uniqueEPGKey(ref), ev_data, (dref.getTransportStreamID().get()<<16)|dref.getOriginalNetworkID().get(), evt);
 					}
 				}
 				if (ev_data)
 				{
-					if (handleEvent(&evt, dest_list, argstring, argcount, service, nowTime, service_name, convertFunc, convertFuncArgs))
+					if (handleEvent(evt, dest_list, argstring, argcount, service, nowTime, service_name, convertFunc, convertFuncArgs))
 						return 0; // error
 				}
 				else if (forceReturnOne && handleEvent(0, dest_list, argstring, argcount, service, nowTime, service_name, convertFunc, convertFuncArgs))
@@ -2096,6 +3105,97 @@ skip_entry:
 	return dest_list;
 }
 
+extern void PutToDict(ePyObject &dict, const char*key, long value); // defined in dvb/frontend.cpp
+
+PyObject *eEPGCache::getSectionStatistics()
+{
+	ePyObject dict = PyDict_New();
+	PutToDict(dict, "hits", m_section_hits);
+	PutToDict(dict, "misses", m_section_misses);
+	PutToDict(dict, "entries", m_section_entries);
+	return dict;
+}
+
+PyObject *eEPGCache::getEventCacheStatistics()
+{
+	singleLock s(cache_lock);
+	ePyObject dict = PyDict_New();
+	PutToDict(dict, "hits", m_decoded_hits);
+	PutToDict(dict, "misses", m_decoded_misses);
+	PutToDict(dict, "entries", (long)m_decoded_index.size());
+	return dict;
+}
+
+// here we get a python list of service reference strings
+// for each service all events which intersect the time range from begin
+// ( -1 for now_time ) for the given minutes are returned. the result is a
+// python string containing the packed events in the order of the given
+// services, the layout is described in lib/dvb/epgpack.h
+
+PyObject *eEPGCache::lookupEventsPacked(ePyObject services, time_t begin, int minutes)
+{
+	if (!PyList_Check(services))
+	{
+		PyErr_SetString(PyExc_StandardError,
+			"type error");
+		eDebug("no list");
+		return NULL;
+	}
+	if (begin == -1)
+		begin = ::time(0);
+	time_t end = begin + minutes * 60;
+
+	int size = PyList_Size(services);
+	std::vector<eServiceReferenceDVB> refs;
+	refs.reserve(size);
+	for (int i = 0; i < size; ++i)
+	{
+		ePyObject entry = PyList_GET_ITEM(services, i); // borrowed reference!
+		eServiceReference ref;
+		if (PyString_Check(entry))
+			ref = handleGroup(eServiceReference(PyString_AS_STRING(entry)));
+		else
+			eDebug("list entry %d is no a string", i);
+		// redirect subservice querys to parent service
+		eServiceReferenceDVB &dvb_ref = (eServiceReferenceDVB&)ref;
+		if (ref.type == eServiceReference::idDVB && dvb_ref.getParentTransportStreamID().get()) // linkage subservice
+		{
+			dvb_ref.setTransportStreamID( dvb_ref.getParentTransportStreamID() );
+			dvb_ref.setServiceID( dvb_ref.getParentServiceID() );
+		}
+		refs.push_back(dvb_ref);
+	}
+
+	eEPGPackedResult result(size, size * 8);
+	{
+		singleLock s(cache_lock);
+		for (std::vector<eServiceReferenceDVB>::iterator it(refs.begin()); it != refs.end(); ++it)
+		{
+			result.addService();
+			if (it->type != eServiceReference::idDVB)
+				continue;
+			eventCache::iterator service = eventDB.find(*it);
+			if (service == eventDB.end())
+				continue;
+			timeMap &tmMap = service->second.second;
+			timeMap::iterator cursor = tmMap.lower_bound(begin);
+			if (cursor != tmMap.begin())
+			{
+				timeMap::iterator x = cursor - 1;
+				if (x->first + x->second->getDuration() > begin)
+					cursor = x;
+			}
+			int tsidonid = (it->getTransportStreamID().get()<<16) | it->getOriginalNetworkID().get();
+			for (; cursor != tmMap.end() && cursor->first < end; ++cursor)
+				result.addEvent(cursor->second, tsidonid);
+		}
+	}
+
+	std::string packed;
+	result.finish(packed);
+	return PyString_FromStringAndSize(packed.data(), packed.size());
+}
+
 void fillTuple2(ePyObject tuple, const char *argstring, int argcount, eventData *evData, eServiceEvent *ptr, ePyObject service_name, ePyObject service_reference)
 {
 	ePyObject tmp;
@@ -2181,6 +3281,85 @@ void fillTuple2(ePyObject tuple, const char *argstring, int argcount, eventData
 //     0 = case sensitive (CASE_CHECK)
 //     1 = case insensitive (NO_CASECHECK)
 
+// collects the crcs of all short event descriptors with a matching title
+struct titleMatcher
+{
+	int querytype, casetype;
+	const char *str;
+	int textlen;
+	__u32 *descr;
+	int &descridx;
+	titleMatcher(int querytype, int casetype, const char *str, int textlen, __u32 *descr, int &descridx)
+		:querytype(querytype), casetype(casetype), str(str), textlen(textlen), descr(descr), descridx(descridx)
+	{
+	}
+	bool operator()(__u32 crc, int, const __u8 *data)
+	{
+		if ( data[0] == 0x4D ) // short event descriptor
+		{
+			int title_len = data[5];
+			if ( querytype == 1 )
+			{
+				int offs = 6;
+				// skip DVB-Text Encoding!
+				if (data[6] == 0x10)
+				{
+					offs+=3;
+					title_len-=3;
+				}
+				else if(data[6] > 0 && data[6] < 0x20)
+				{
+					offs+=1;
+					title_len-=1;
+				}
+				if (title_len != textlen)
+					return true;
+				if ( casetype )
+				{
+					if ( !strncasecmp((const char*)data+offs, str, title_len) )
+					{
+//						std::string s((const char*)data+offs, title_len);
+//						eDebug("match1 %s %s", str, s.c_str() );
+						descr[++descridx] = crc;
+					}
+				}
+				else if ( !strncmp((const char*)data+offs, str, title_len) )
+				{
+//					std::string s((const char*)data+offs, title_len);
+//					eDebug("match2 %s %s", str, s.c_str() );
+					descr[++descridx] = crc;
+				}
+			}
+			else
+			{
+				int idx=0;
+				while((title_len-idx) >= textlen)
+				{
+					if (casetype)
+					{
+						if (!strncasecmp((const char*)data+6+idx, str, textlen) )
+						{
+							descr[++descridx] = crc;
+//							std::string s((const char*)data+6, title_len);
+//							eDebug("match 3 %s %s", str, s.c_str() );
+							break;
+						}
+					}
+					else if (!strncmp((const char*)data+6+idx, str, textlen) )
+					{
+						descr[++descridx] = crc;
+//						std::string s((const char*)data+6, title_len);
+//						eDebug("match 4 %s %s", str, s.c_str() );
+						break;
+					}
+					++idx;
+				}
+			}
+		}
+		return descridx < 511;
+	}
+};
+
 PyObject *eEPGCache::search(ePyObject arg)
 {
 	ePyObject ret;
@@ -2266,11 +3445,9 @@ PyObject *eEPGCache::search(ePyObject arg)
 							while(tmp>3)
 							{
 								__u32 crc = *p++;
-								descriptorMap::iterator it =
-									eventData::descriptors.find(crc);
-								if (it != eventData::descriptors.end())
+								const __u8 *descr_data = eventData::descriptors.lookup(crc);
+								if (descr_data)
 								{
-									__u8 *descr_data = it->second.second;
 									switch(descr_data[0])
 									{
 									case 0x4D ... 0x4E:
@@ -2316,70 +3493,17 @@ PyObject *eEPGCache::search(ePyObject arg)
 					else
 						eDebug("lookup for events with '%s' in title(%s)", str, casetype?"ignore case":"case sensitive");
 					singleLock s(cache_lock);
-					for (descriptorMap::iterator it(eventData::descriptors.begin());
-						it != eventData::descriptors.end() && descridx < 511; ++it)
+					titleMatcher matcher(querytype, casetype, str, textlen, descr, descridx);
+					std::vector<__u32> crcs;
+					if (eventData::titles.candidates(str, textlen, crcs) < 0)
+						eventData::descriptors.forEach(matcher); // too short for the title index
+					else
 					{
-						__u8 *data = it->second.second;
-						if ( data[0] == 0x4D ) // short event descriptor
+						for (std::vector<__u32>::iterator it(crcs.begin()); it != crcs.end(); ++it)
 						{
-							int title_len = data[5];
-							if ( querytype == 1 )
-							{
-								int offs = 6;
-								// skip DVB-Text Encoding!
-								if (data[6] == 0x10)
-								{
-									offs+=3;
-									title_len-=3;
-								}
-								else if(data[6] > 0 && data[6] < 0x20)
-								{
-									offs+=1;
-									title_len-=1;
-								}
-								if (title_len != textlen)
-									continue;
-								if ( casetype )
-								{
-									if ( !strncasecmp((const char*)data+offs, str, title_len) )
-									{
-//										std::string s((const char*)data+offs, title_len);
-//										eDebug("match1 %s %s", str, s.c_str() );
-										descr[++descridx] = it->first;
-									}
-								}
-								else if ( !strncmp((const char*)data+offs, str, title_len) )
-								{
-//									std::string s((const char*)data+offs, title_len);
-//									eDebug("match2 %s %s", str, s.c_str() );
-									descr[++descridx] = it->first;
-								}
-							}
-							else
-							{
-								int idx=0;
-								while((title_len-idx) >= textlen)
-								{
-									if (casetype)
-									{
-										if (!strncasecmp((const char*)data+6+idx, str, textlen) )
-										{
-											descr[++descridx] = it->first;
-//											std::string s((const char*)data+6, title_len);
-//											eDebug("match 3 %s %s", str, s.c_str() );
-											break;
-										}
-									}
-									else if (!strncmp((const char*)data+6+idx, str, textlen) )
-									{
-										descr[++descridx] = it->first;
-//										std::string s((const char*)data+6, title_len);
-//										eDebug("match 4 %s %s", str, s.c_str() );
-										break;
-									}
-									++idx;
-								}
-							}
+							const __u8 *data = eventData::descriptors.lookup(*it);
+							if (data && !matcher(*it, 0, data))
+								break;
 						}
 					}
 				}
@@ -2693,31 +3817,31 @@ struct less_datetime
 
 void eEPGCache::privateSectionRead(const uniqueEPGKey &current_service, const __u8 *data)
 {
-	contentMap &content_time_table = content_time_tables[current_service];
 	singleLock s(cache_lock);
+	eEPGContentTable &content_table = content_time_tables[current_service];
 	std::map< date_time, std::list<uniqueEPGKey>, less_datetime > start_times;
 	eventMap &evMap = eventDB[current_service].first;
 	timeMap &tmMap = eventDB[current_service].second;
+	m_dirty.insert(current_service);
 	int ptr=8;
 	int content_id = data[ptr++] << 24;
 	content_id |= data[ptr++] << 16;
 	content_id |= data[ptr++] << 8;
 	content_id |= data[ptr++];
 
-	contentTimeMap &time_event_map =
-		content_time_table[content_id];
-	for ( contentTimeMap::iterator it( time_event_map.begin() );
-		it != time_event_map.end(); ++it )
+	size_t first, last;
+	content_table.find(content_id, first, last);
+	for ( size_t i = first; i < last; ++i )
 	{
-		eventMap::iterator evIt( evMap.find(it->second.second) );
+		eventMap::iterator evIt( evMap.find(content_table.eventId(i)) );
 		if ( evIt != evMap.end() )
 		{
 			delete evIt->second;
 			evMap.erase(evIt);
 		}
-		tmMap.erase(it->second.first);
+		tmMap.erase(content_table.start(i));
 	}
-	time_event_map.clear();
+	std::vector<eEPGContentTable::entry> entries;
 
 	__u8 duration[3];
 	memcpy(duration, data+ptr, 3);
@@ -2844,12 +3968,13 @@ void eEPGCache::privateSectionRead(const uniqueEPGKey &current_service, const __
 			++event_id;
 		event[0] = (event_id & 0xFF00) >> 8;
 		event[1] = (event_id & 0xFF);
-		time_event_map[it->first.tm]=std::pair<time_t, __u16>(stime, event_id);
+		entries.push_back(eEPGContentTable::entry(it->first.tm, stime, event_id));
 		eventData *d = new eventData( ev_struct, bptr, PRIVATE );
 		evMap[event_id] = d;
 		tmMap[stime] = d;
 		ASSERT(bptr <= 4098);
 	}
+	content_table.replace(content_id, entries);
 }
 
 void eEPGCache::channel_data::startPrivateReader()
@@ -37,10 +37,23 @@
 #include <lib/base/ebase.h>
 #include <lib/base/thread.h>
 #include <lib/base/message.h>
+#include <lib/base/flatmap.h>
+#include <lib/base/slaballoc.h>
+#include <lib/dvb/epgcontent.h>
+#include <lib/dvb/epgdescriptors.h>
+#include <lib/dvb/epgindex.h>
+#include <lib/dvb/epgwriter.h>
 #include <lib/service/event.h>
 #include <lib/python/python.h>
 
 #define CLEAN_INTERVAL 60000    //  1 min
+#define CLEAN_BUCKET 60 // seconds per bucket of the cleanloop queue
+#define CLEAN_SLICE 32 // services cleaned at once
+#define CLEAN_SLICE_DELAY 20 // ms between two slices
+#define HOUSEKEEPING_INTERVAL 60*60 // 1 hour
+#define DECODED_EVENTS 256 // size of the decoded event cache
+#define CHECKPOINT_INTERVAL 600000 // 10 min
+#define SECTION_FINGERPRINT_TIMEOUT 6*60*60 // 6 hours
 #define UPDATE_INTERVAL 3600000  // 60 min
 #define ZAP_DELAY 2000          // 2 sek
 
@@ -48,6 +61,7 @@
 
 class eventData;
 class eServiceReferenceDVB;
+class eEPGSectionDecoder;
 class eDVBServicePMTHandler;
 
 struct uniqueEPGKey
@@ -89,9 +103,9 @@ struct uniqueEPGKey
 };
 
 //eventMap is sorted by event_id
-#define eventMap std::map<__u16, eventData*>
+#define eventMap eFlatMap<__u16, eventData*>
 //timeMap is sorted by beginTime
-#define timeMap std::map<time_t, eventData*>
+#define timeMap eFlatMap<time_t, eventData*>
 
 #define channelMapIterator std::map<iDVBChannel*, channel_data*>::iterator
 #define updateMap std::map<eDVBChannelID, time_t>
@@ -108,29 +122,20 @@ struct hash_uniqueEPGKey
 #if 0 && __GNUC_PREREQ(4,3)
 	#define eventCache std::unordered_map<uniqueEPGKey, std::pair<eventMap, timeMap>, hash_uniqueEPGKey, uniqueEPGKey::equal>
 	#ifdef ENABLE_PRIVATE_EPG
-		#define contentTimeMap std::unordered_map<time_t, std::pair<time_t, __u16> >
-		#define contentMap std::unordered_map<int, contentTimeMap >
-		#define contentMaps std::unordered_map<uniqueEPGKey, contentMap, hash_uniqueEPGKey, uniqueEPGKey::equal >
+		#define contentMaps std::unordered_map<uniqueEPGKey, eEPGContentTable, hash_uniqueEPGKey, uniqueEPGKey::equal >
 	#endif
 #elif __GNUC_PREREQ(3,1)
 	#define eventCache __gnu_cxx::hash_map<uniqueEPGKey, std::pair<eventMap, timeMap>, hash_uniqueEPGKey, uniqueEPGKey::equal>
 	#ifdef ENABLE_PRIVATE_EPG
-		#define contentTimeMap __gnu_cxx::hash_map<time_t, std::pair<time_t, __u16> >
-		#define contentMap __gnu_cxx::hash_map<int, contentTimeMap >
-		#define contentMaps __gnu_cxx::hash_map<uniqueEPGKey, contentMap, hash_uniqueEPGKey, uniqueEPGKey::equal >
+		#define contentMaps __gnu_cxx::hash_map<uniqueEPGKey, eEPGContentTable, hash_uniqueEPGKey, uniqueEPGKey::equal >
 	#endif
 #else // for older gcc use following
 	#define eventCache std::hash_map<uniqueEPGKey, std::pair<eventMap, timeMap>, hash_uniqueEPGKey, uniqueEPGKey::equal >
 	#ifdef ENABLE_PRIVATE_EPG
-		#define contentTimeMap std::hash_map<time_t, std::pair<time_t, __u16> >
-		#define contentMap std::hash_map<int, contentTimeMap >
-		#define contentMaps std::hash_map<uniqueEPGKey, contentMap, hash_uniqueEPGKey, uniqueEPGKey::equal>
+		#define contentMaps std::hash_map<uniqueEPGKey, eEPGContentTable, hash_uniqueEPGKey, uniqueEPGKey::equal>
 	#endif
 #endif
 
-#define descriptorPair std::pair<int,__u8*>
-#define descriptorMap std::map<__u32, descriptorPair >
-
 class eventData
 {
 	friend class eEPGCache;
@@ -138,15 +143,31 @@ private:
 	__u8* EITdata;
 	__u8 ByteSize;
 	__u8 type;
-	static descriptorMap descriptors;
+	static eEPGTitleIndex titles;
+	static eEPGDescriptorStore descriptors;
 	static __u8 data[4108];
+	// eventData objects and their EITdata are allocated from this arena.
+	// arena and CacheSize are protected by arena_lock, so events can be
+	// created without holding eEPGCache::cache_lock
+	static pthread_mutex_t arena_lock;
 	static int CacheSize;
+	static eSlabAllocator arena;
+	// events loaded from a mapped epg.dat keep their EITdata and descriptors
+	// in the mapping until they are replaced or removed, the mapping is
+	// released together with the last of them. protected by arena_lock
+	static __u8 *mapped_data;
+	static size_t mapped_size;
+	static int mapped_refs;
+	static void releaseMapped(int refs);
+	bool isMapped() const { return EITdata >= mapped_data && EITdata < mapped_data + mapped_size; }
 	static void load(FILE *);
-	static void save(FILE *);
 public:
 	eventData(const eit_event_struct* e=NULL, int size=0, int type=0);
 	~eventData();
+	static void *operator new(size_t size);
+	static void operator delete(void *p, size_t size);
 	const eit_event_struct* get() const;
+	static int getCacheSize() { return CacheSize; }
 	operator const eit_event_struct*() const
 	{
 		return get();
@@ -179,6 +200,7 @@ class eEPGCache: public eMainloop, private eThread, public Object
 		int prevChannelState;
 		int state;
 		__u8 isRunning, haveData;
+		int crcErrors;
 		ePtr<eDVBChannel> channel;
 		ePtr<eConnection> m_stateChangedConn, m_NowNextConn, m_ScheduleConn, m_ScheduleOtherConn, m_ViasatConn;
 		ePtr<iDVBSectionReader> m_NowNextReader, m_ScheduleReader, m_ScheduleOtherReader, m_ViasatReader;
@@ -274,9 +296,10 @@ public:
 	eFixedMessagePump<Message> messages;
 private:
 	friend class channel_data;
+	friend class eEPGSectionDecoder;
 	static eEPGCache *instance;
 
-	ePtr<eTimer> cleanTimer;
+	ePtr<eTimer> cleanTimer, checkpointTimer;
 	std::map<iDVBChannel*, channel_data*> m_knownChannels;
 	ePtr<eConnection> m_chanAddedConn;
 
@@ -293,15 +316,98 @@ private:
 // called from epgcache thread
 	int m_running;
 	char m_filename[1024];
+	// the cache file is a V8 snapshot plus a journal with the services
+	// changed since then. m_generation links both, the journal is only
+	// replayed on the snapshot it was written for. m_generation and
+	// m_have_snapshot follow the snapshot on disk, they are advanced when
+	// the writer reports it renamed, no journal is written meanwhile
+	eEPGCacheWriter *m_writer;
+	__u32 m_generation;
+	__u32 m_snapshot_generation; // of the newest snapshot queued
+	int m_pending_snapshots;
+	bool m_have_snapshot;
+	size_t m_journal_size;
+	std::set<uniqueEPGKey> m_dirty; // changed since the last checkpoint, protected by cache_lock
+	__gnu_cxx::hash_set<__u32> m_saved_descriptors; // crcs in the snapshot or the journal
+	void checkpoint();
 	void save();
+	void snapshotWritten(const eEPGCacheWriter::Result &result);
+	void buildSnapshot(std::vector<__u8> &data, __u32 generation);
+	void buildJournal(std::vector<__u8> &data);
 	void load();
+	void loadMapped(FILE *);
+	void replayJournal();
+#ifdef ENABLE_PRIVATE_EPG
+	void loadPrivateEPG(FILE *);
+	bool loadPrivateTables(const __u8 *data, size_t len);
+#endif
 #ifdef ENABLE_PRIVATE_EPG
 	void privateSectionRead(const uniqueEPGKey &, const __u8 *);
 #endif
 	void sectionRead(const __u8 *data, int source, channel_data *channel);
+	void sectionRead(const uniqueEPGKey &service, const __u8 *data, int source);
+	// sectionRead split up for eEPGSectionDecoder
+	eEPGSectionDecoder *m_decoder;
+	void queueSection(const __u8 *data, int source, channel_data *channel);
+	uniqueEPGKey sectionService(const __u8 *data, int source, channel_data *channel);
+	static int parseSection(const __u8 *data, int source, eventData **events);
+	void mergeEvents(const uniqueEPGKey &service, int source, eventData **events, int count);
+	// version and crc of the decoded eit sections per service, table and
+	// section number. unchanged sections are not decoded again, also
+	// after a zap. only used by the epg thread
+	struct sectionFingerprint
+	{
+		__u32 crc;
+		__u8 version;
+		__u32 generation;
+		time_t time;
+	};
+	struct hash_sectionKey
+	{
+		inline size_t operator()(__u64 x) const
+		{
+			return (size_t)(x ^ (x >> 32));
+		}
+	};
+	__gnu_cxx::hash_map<__u64, sectionFingerprint, hash_sectionKey> m_section_fingerprints;
+	// bumped when a merge removes events of a service which may belong to
+	// other sections, the fingerprints of older generations are not used
+	typedef __gnu_cxx::hash_map<uniqueEPGKey, __u32, hash_uniqueEPGKey, uniqueEPGKey::equal> sectionGenerations;
+	sectionGenerations m_section_generations;
+	int m_section_hits, m_section_misses, m_section_entries;
+	bool sectionUnchanged(const uniqueEPGKey &service, const __u8 *data);
 	void gotMessage(const Message &message);
 	void flushEPG(const uniqueEPGKey & s=uniqueEPGKey());
 	void cleanLoop();
+	// calendar queue of the services by the end time of their first event,
+	// m_clean_scheduled is the bucket a service is currently queued in.
+	// protected by cache_lock
+	typedef __gnu_cxx::hash_map<uniqueEPGKey, time_t, hash_uniqueEPGKey, uniqueEPGKey::equal> cleanSchedule;
+	std::map<time_t, std::vector<uniqueEPGKey> > m_clean_queue;
+	cleanSchedule m_clean_scheduled;
+	bool m_clean_all; // rebuild the queue (after load)
+	time_t m_last_housekeeping;
+	void scheduleClean(const uniqueEPGKey &service, timeMap &tmMap);
+	int cleanService(eventCache::iterator DBIt, time_t now);
+	// the last decoded eServiceEvents, the most recently used first. an
+	// entry is only used while the cached EITdata is unchanged (the event
+	// itself, its descriptors) and for the same epg language.
+	// protected by cache_lock
+	struct decodedEvent
+	{
+		__u64 key;
+		int tsidonid;
+		std::string eit;
+		ePtr<eServiceEvent> event;
+	};
+	std::list<decodedEvent> m_decoded;
+	__gnu_cxx::hash_map<__u64, std::list<decodedEvent>::iterator, hash_sectionKey> m_decoded_index;
+	std::string m_decoded_language;
+	int m_decoded_hits, m_decoded_misses;
+	static __u64 decodedKey(const uniqueEPGKey &service, __u16 event_id);
+	RESULT decodeEvent(const uniqueEPGKey &service, const eventData *data, int tsidonid, ePtr<eServiceEvent> &result);
+	void invalidateDecoded(const uniqueEPGKey &service, __u16 event_id);
+	void printMemoryUsage();
 
 // called from main thread
 	void timeUpdated();
@@ -309,7 +415,10 @@ private:
 	void DVBChannelStateChanged(iDVBChannel*);
 	void DVBChannelRunning(iDVBChannel *);
 
-	timeMap::iterator m_timemap_cursor, m_timemap_end;
+	// state of the current time query, kept as keys and not as iterators,
+	// because the flat maps may be modified between getNextTimeEntry calls
+	uniqueEPGKey m_timemap_service;
+	time_t m_timemap_cursor, m_timemap_end; // m_timemap_end is -1 when not limited
 	int currentQueryTsidOnid; // needed for getNextTimeEntry.. only valid until next startTimeQuery call
 #else
 	eEPGCache();
@@ -356,6 +465,10 @@ public:
 	RESULT lookupEventId(const eServiceReference &service, int event_id, Event* &);
 	RESULT lookupEventTime(const eServiceReference &service, time_t, Event* &, int direction=0);
 	RESULT getNextTimeEntry(Event *&);
+
+	// takes an eit section into the cache like read on its own transponder,
+	// without channel and epg thread (for enigma-epgbench)
+	void replaySection(const __u8 *data);
 #endif
 	enum {
 		SIMILAR_BROADCASTINGS_SEARCH,
@@ -368,6 +481,12 @@ public:
 	};
 	PyObject *lookupEvent(SWIG_PYOBJECT(ePyObject) list, SWIG_PYOBJECT(ePyObject) convertFunc=(PyObject*)0);
 	PyObject *search(SWIG_PYOBJECT(ePyObject));
+	// events of all given services in the time range as one packed buffer (see epgpack.h)
+	PyObject *lookupEventsPacked(SWIG_PYOBJECT(ePyObject) services, time_t begin=-1, int minutes=360);
+	// dict with the hits, misses and entries of the eit section fingerprints
+	PyObject *getSectionStatistics();
+	// dict with the hits, misses and entries of the decoded event cache
+	PyObject *getEventCacheStatistics();
 
 	// eServiceEvent are parsed epg events.. it's safe to use them after cache unlock
 	// for use from python ( members: m_start_time, m_duration, m_short_description, m_extended_description )
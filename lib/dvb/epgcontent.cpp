@@ -0,0 +1,111 @@
+#include <lib/dvb/epgcontent.h>
+#include <algorithm>
+#include <string.h>
+
+void eEPGContentTable::clear()
+{
+	std::vector<__s32>().swap(m_content_id);
+	std::vector<time_t>().swap(m_time);
+	std::vector<time_t>().swap(m_start);
+	std::vector<__u16>().swap(m_event_id);
+}
+
+void eEPGContentTable::find(int content_id, size_t &first, size_t &last) const
+{
+	std::pair<std::vector<__s32>::const_iterator, std::vector<__s32>::const_iterator> range =
+		std::equal_range(m_content_id.begin(), m_content_id.end(), (__s32)content_id);
+	first = range.first - m_content_id.begin();
+	last = range.second - m_content_id.begin();
+}
+
+void eEPGContentTable::replace(int content_id, std::vector<entry> &entries)
+{
+	size_t first, last;
+	find(content_id, first, last);
+	std::sort(entries.begin(), entries.end());
+	size_t n = entries.size(), old = last - first;
+
+	// make room for the new entries in all columns, then fill them
+	if (n > old)
+	{
+		m_content_id.insert(m_content_id.begin() + last, n - old, content_id);
+		m_time.insert(m_time.begin() + last, n - old, 0);
+		m_start.insert(m_start.begin() + last, n - old, 0);
+		m_event_id.insert(m_event_id.begin() + last, n - old, 0);
+	}
+	else if (n < old)
+	{
+		m_content_id.erase(m_content_id.begin() + first + n, m_content_id.begin() + last);
+		m_time.erase(m_time.begin() + first + n, m_time.begin() + last);
+		m_start.erase(m_start.begin() + first + n, m_start.begin() + last);
+		m_event_id.erase(m_event_id.begin() + first + n, m_event_id.begin() + last);
+	}
+	for (size_t i = 0; i < n; ++i)
+	{
+		m_time[first + i] = entries[i].time;
+		m_start[first + i] = entries[i].start;
+		m_event_id[first + i] = entries[i].event_id;
+	}
+}
+
+void eEPGContentTable::compact()
+{
+	if (m_content_id.capacity() <= 2 * m_content_id.size())
+		return;
+	std::vector<__s32>(m_content_id).swap(m_content_id);
+	std::vector<time_t>(m_time).swap(m_time);
+	std::vector<time_t>(m_start).swap(m_start);
+	std::vector<__u16>(m_event_id).swap(m_event_id);
+}
+
+template <class T>
+static inline void put(std::vector<__u8> &data, const std::vector<T> &v)
+{
+	if (!v.empty())
+		data.insert(data.end(), (const __u8*)&v[0], (const __u8*)&v[0] + v.size() * sizeof(T));
+}
+
+void eEPGContentTable::serialize(std::vector<__u8> &data) const
+{
+	__u32 count = m_content_id.size();
+	data.insert(data.end(), (const __u8*)&count, (const __u8*)&count + sizeof(__u32));
+	put(data, m_content_id);
+	put(data, m_time);
+	put(data, m_start);
+	put(data, m_event_id);
+	if (count & 1)
+		data.insert(data.end(), sizeof(__u16), 0);
+}
+
+template <class T>
+static inline const __u8 *get(std::vector<T> &v, const __u8 *data, size_t count)
+{
+	v.resize(count);
+	if (count)
+		memcpy(&v[0], data, count * sizeof(T));
+	return data + count * sizeof(T);
+}
+
+int eEPGContentTable::deserialize(const __u8 *data, size_t len)
+{
+	__u32 count;
+	if (len < sizeof(__u32))
+		return -1;
+	memcpy(&count, data, sizeof(__u32));
+	size_t size = sizeof(__u32) + (unsigned long long)count * (sizeof(__s32) + 2 * sizeof(time_t)) +
+		((count * sizeof(__u16) + 3) & ~3);
+	if (count > len || size > len)
+		return -1;
+	const __u8 *p = data + sizeof(__u32);
+	p = get(m_content_id, p, count);
+	p = get(m_time, p, count);
+	p = get(m_start, p, count);
+	get(m_event_id, p, count);
+	return size;
+}
+
+size_t eEPGContentTable::memoryUsage() const
+{
+	return m_content_id.capacity() * sizeof(__s32) + (m_time.capacity() + m_start.capacity()) * sizeof(time_t) +
+		m_event_id.capacity() * sizeof(__u16);
+}
@@ -0,0 +1,93 @@
+#ifndef __lib_dvb_epgcontent_h
+#define __lib_dvb_epgcontent_h
+
+#include <vector>
+#include <time.h>
+#include <asm/types.h>
+
+/**
+ * \brief The private epg content table of one service.
+ *
+ * Maps the content id and the nominal start time of the private (OpenTV)
+ * events to the start time and event id they got in the epg cache. The
+ * entries are kept as struct of arrays sorted by content id and time, so
+ * the entries of a content id are found by binary search and a service
+ * costs a few bytes per entry instead of three levels of hash_map nodes.
+ *
+ * The serialized form is the same columns in one block, native byte order:
+ *
+ *   __u32 count
+ *   __s32 content_id[count]
+ *   time_t time[count]
+ *   time_t start[count]
+ *   __u16 event_id[count]   padded to a multiple of 4 bytes
+ */
+class eEPGContentTable
+{
+public:
+	struct entry
+	{
+		time_t time, start;
+		__u16 event_id;
+		entry(time_t time, time_t start, __u16 event_id)
+			:time(time), start(start), event_id(event_id)
+		{
+		}
+		bool operator<(const entry &e) const { return time < e.time; }
+	};
+
+	size_t size() const { return m_content_id.size(); }
+	bool empty() const { return m_content_id.empty(); }
+	void clear();
+
+		/* the entries of content_id are first .. last-1 */
+	void find(int content_id, size_t &first, size_t &last) const;
+	int contentId(size_t i) const { return m_content_id[i]; }
+	time_t time(size_t i) const { return m_time[i]; }
+	time_t start(size_t i) const { return m_start[i]; }
+	__u16 eventId(size_t i) const { return m_event_id[i]; }
+
+		/* replaces all entries of content_id */
+	void replace(int content_id, std::vector<entry> &entries);
+		/* removes the entries for which pred(start, event_id) is true, returns
+		   the number of removed entries */
+	template<class P> size_t remove_if(P pred);
+
+	void serialize(std::vector<__u8> &data) const;
+		/* returns the bytes used or -1 when the block is truncated */
+	int deserialize(const __u8 *data, size_t len);
+	size_t memoryUsage() const;
+private:
+	std::vector<__s32> m_content_id;
+	std::vector<time_t> m_time, m_start;
+	std::vector<__u16> m_event_id;
+	void compact();
+};
+
+template<class P>
+size_t eEPGContentTable::remove_if(P pred)
+{
+	size_t n = 0;
+	for (size_t i = 0; i < m_content_id.size(); ++i)
+	{
+		if (pred(m_start[i], m_event_id[i]))
+			continue;
+		m_content_id[n] = m_content_id[i];
+		m_time[n] = m_time[i];
+		m_start[n] = m_start[i];
+		m_event_id[n] = m_event_id[i];
+		++n;
+	}
+	size_t removed = m_content_id.size() - n;
+	if (removed)
+	{
+		m_content_id.resize(n);
+		m_time.resize(n);
+		m_start.resize(n);
+		m_event_id.resize(n);
+		compact();
+	}
+	return removed;
+}
+
+#endif
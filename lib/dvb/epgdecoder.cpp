@@ -0,0 +1,141 @@
+#include <lib/dvb/epgdecoder.h>
+#include <lib/base/eerror.h>
+#include <string.h>
+#include <unistd.h>
+
+eEPGSectionDecoder::worker::worker(eEPGSectionDecoder *decoder)
+	:m_decoder(decoder)
+{
+	run();
+}
+
+eEPGSectionDecoder::worker::~worker()
+{
+	kill();
+}
+
+void eEPGSectionDecoder::worker::thread()
+{
+	hasStarted();
+	nice(4); // like the epg thread
+	while (1)
+	{
+		while (sem_wait(&m_decoder->m_queued) < 0)
+			;
+		if (m_decoder->m_stop)
+			break;
+		unsigned int n = __sync_fetch_and_add(&m_decoder->m_claim, 1);
+		m_decoder->decode(m_decoder->m_jobs[n % JOBS]);
+	}
+}
+
+eEPGSectionDecoder::eEPGSectionDecoder(eEPGCache *cache, eMainloop *context, int workers)
+	:m_cache(cache), m_head(0), m_tail(0), m_claim(0), m_notify(0), m_stop(false),
+	m_done(context, 1)
+{
+	m_jobs = new job[JOBS];
+	for (int i = 0; i < JOBS; ++i)
+		m_jobs[i].state = jobFree;
+	sem_init(&m_queued, 0, 0);
+	CONNECT(m_done.recv_msg, eEPGSectionDecoder::gotMessage);
+	for (int i = 0; i < workers; ++i)
+		m_workers.push_back(new worker(this));
+	eDebug("[EPGC] %d eit decoder threads started", workers);
+}
+
+eEPGSectionDecoder::~eEPGSectionDecoder()
+{
+	m_stop = true;
+	for (size_t i = 0; i < m_workers.size(); ++i)
+		sem_post(&m_queued);
+	for (size_t i = 0; i < m_workers.size(); ++i)
+		delete m_workers[i];
+	// sections not merged yet are dropped
+	for (; m_tail != m_head; ++m_tail)
+	{
+		job &j = m_jobs[m_tail % JOBS];
+		if (j.state == jobDone)
+			for (int i = 0; i < j.count; ++i)
+				delete j.events[i];
+	}
+	sem_destroy(&m_queued);
+	delete [] m_jobs;
+}
+
+void eEPGSectionDecoder::decode(job &j)
+{
+	int size = (((j.data[1] & 0x0F) << 8) | j.data[2]) + 3;
+	if (size > 4096)
+		j.count = 0;
+	else
+		j.count = eEPGCache::parseSection(j.data, j.source, j.events);
+	__sync_synchronize();
+	j.state = jobDone;
+	if (__sync_bool_compare_and_swap(&m_notify, 0, 1))
+		m_done.send(0);
+}
+
+void eEPGSectionDecoder::push(const __u8 *data, int source, const uniqueEPGKey &service)
+{
+	while (m_head - m_tail == JOBS)
+	{
+		if (!merge())
+			usleep(1000); // all workers busy
+	}
+	job &j = m_jobs[m_head % JOBS];
+	int size = (((data[1] & 0x0F) << 8) | data[2]) + 3;
+	memcpy(j.data, data, size > 4096 ? 4096 : size);
+	j.service = service;
+	j.source = source;
+	j.state = jobQueued;
+	__sync_synchronize();
+	++m_head;
+	sem_post(&m_queued);
+}
+
+int eEPGSectionDecoder::merge()
+{
+	m_notify = 0;
+	__sync_synchronize();
+	unsigned int end = m_tail;
+	while (end != m_head && m_jobs[end % JOBS].state == jobDone)
+		++end;
+	if (end == m_tail)
+		return 0;
+	__sync_synchronize();
+
+	{
+		singleLock s(eEPGCache::cache_lock);
+		for (unsigned int n = m_tail; n != end; ++n)
+		{
+			job &j = m_jobs[n % JOBS];
+			if (j.count > 0)
+				m_cache->mergeEvents(j.service, j.source, j.events, j.count);
+		}
+	}
+
+	// events which were not taken are freed without holding cache_lock
+	int merged = end - m_tail;
+	for (; m_tail != end; ++m_tail)
+	{
+		job &j = m_jobs[m_tail % JOBS];
+		for (int i = 0; i < j.count; ++i)
+			delete j.events[i];
+		j.state = jobFree;
+	}
+	return merged;
+}
+
+void eEPGSectionDecoder::flush()
+{
+	while (m_tail != m_head)
+	{
+		if (!merge())
+			usleep(1000);
+	}
+}
+
+void eEPGSectionDecoder::gotMessage(const int &)
+{
+	merge();
+}
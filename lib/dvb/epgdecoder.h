@@ -0,0 +1,73 @@
+#ifndef __lib_dvb_epgdecoder_h
+#define __lib_dvb_epgdecoder_h
+
+#include <vector>
+#include <semaphore.h>
+#include <asm/types.h>
+#include <lib/base/thread.h>
+#include <lib/base/message.h>
+#include <lib/dvb/epgcache.h>
+
+/**
+ * \brief Decodes EIT sections for eEPGCache in a pool of worker threads.
+ *
+ * The epg thread only copies the sections into a ring of jobs. The
+ * workers create the eventData objects (hashing and
+ * interning the descriptors), which is most of the work of
+ * eEPGCache::sectionRead. The decoded sections are merged into the cache
+ * by the epg thread in batches, with one cache_lock for all sections
+ * decoded so far and in the order they were received.
+ *
+ * The ring is lock free: only the epg thread queues and merges jobs,
+ * the workers claim the queued jobs with an atomic counter and are woken
+ * by a semaphore.
+ */
+class eEPGSectionDecoder: public Object
+{
+	enum { JOBS = 64 };
+	enum { jobFree, jobQueued, jobDone };
+	struct job
+	{
+		volatile int state;
+		uniqueEPGKey service;
+		int source;
+		int count; // decoded events
+		eventData *events[4096/EIT_LOOP_SIZE];
+		__u8 data[4096];
+	};
+	class worker: public eThread
+	{
+		eEPGSectionDecoder *m_decoder;
+		void thread();
+	public:
+		worker(eEPGSectionDecoder *decoder);
+		~worker();
+	};
+
+	eEPGCache *m_cache;
+	job *m_jobs;
+	unsigned int m_head, m_tail; // only used by the epg thread
+	volatile unsigned int m_claim; // next job to decode
+	volatile int m_notify; // a merge message is on the way
+	volatile bool m_stop;
+	sem_t m_queued;
+	std::vector<worker*> m_workers;
+	eFixedMessagePump<int> m_done;
+
+	void decode(job &j);
+	void gotMessage(const int &);
+public:
+		/* the merge messages are received in the context of the epg thread */
+	eEPGSectionDecoder(eEPGCache *cache, eMainloop *context, int workers);
+	~eEPGSectionDecoder();
+
+		/* queues a copy of the section. when the ring is full the decoded
+		   jobs are merged first, waiting for the workers if needed */
+	void push(const __u8 *data, int source, const uniqueEPGKey &service);
+		/* merges all decoded sections, returns the number of them */
+	int merge();
+		/* waits for all queued sections and merges them */
+	void flush();
+};
+
+#endif
@@ -0,0 +1,150 @@
+#include <lib/dvb/epgdescriptors.h>
+#include <stdlib.h>
+#include <string.h>
+
+eEPGDescriptorStore::shard::shard()
+	:table(0), mask(0), used(0), alloc(16*1024)
+{
+	pthread_mutex_init(&lock, 0);
+}
+
+eEPGDescriptorStore::shard::~shard()
+{
+	::free(table);
+	pthread_mutex_destroy(&lock);
+}
+
+eEPGDescriptorStore::entry *eEPGDescriptorStore::shard::find(__u32 crc)
+{
+	unsigned int i = slot(crc) & mask;
+	while (table[i].descr && table[i].crc != crc)
+		i = (i + 1) & mask;
+	return table + i;
+}
+
+void eEPGDescriptorStore::shard::grow()
+{
+	entry *old = table;
+	unsigned int oldsize = table ? mask + 1 : 0;
+	unsigned int size = oldsize ? oldsize * 2 : 64;
+	table = (entry*)calloc(size, sizeof(entry));
+	mask = size - 1;
+	for (unsigned int i = 0; i < oldsize; ++i)
+		if (old[i].descr)
+			*find(old[i].crc) = old[i];
+	::free(old);
+}
+
+void eEPGDescriptorStore::shard::remove(entry *e)
+{
+	unsigned int i = e - table, j = i;
+	while (1)
+	{
+		j = (j + 1) & mask;
+		if (!table[j].descr)
+			break;
+		/* move the entry back to the hole unless its home slot lies
+		   (cyclically) between the hole and its current position */
+		unsigned int k = slot(table[j].crc) & mask;
+		if (i < j ? (k <= i || k > j) : (k <= i && k > j))
+		{
+			table[i] = table[j];
+			i = j;
+		}
+	}
+	table[i].descr = 0;
+	--used;
+}
+
+eEPGDescriptorStore::eEPGDescriptorStore(listener *l)
+	:m_listener(l)
+{
+}
+
+eEPGDescriptorStore::~eEPGDescriptorStore()
+{
+}
+
+int eEPGDescriptorStore::ref(__u32 crc, const __u8 *descr, int refcount, bool external)
+{
+	shard &s = shardFor(crc);
+	singleLock l(s.lock);
+	if (!s.table || (s.used + 1) * 4 > (s.mask + 1) * 3)
+		s.grow();
+	entry *e = s.find(crc);
+	if (e->descr)
+	{
+		e->refcount += refcount;
+		return 0;
+	}
+	int len = descr[1] + 2;
+	if (external)
+		e->descr = (__u8*)descr;
+	else
+	{
+		e->descr = (__u8*)s.alloc.alloc(len);
+		memcpy(e->descr, descr, len);
+	}
+	e->crc = crc;
+	e->refcount = external ? refcount | EXTERNAL : refcount;
+	++s.used;
+	if (m_listener)
+		m_listener->descriptorAdded(crc, descr);
+	return len;
+}
+
+int eEPGDescriptorStore::unref(__u32 crc, int *external)
+{
+	shard &s = shardFor(crc);
+	singleLock l(s.lock);
+	if (!s.table)
+		return -1;
+	entry *e = s.find(crc);
+	if (!e->descr)
+		return -1;
+	if (--e->refcount & ~EXTERNAL)
+		return 0;
+	int len = e->descr[1] + 2;
+	if (e->refcount & EXTERNAL)
+	{
+		if (external)
+			++*external;
+	}
+	else
+		s.alloc.free(e->descr, len);
+	s.remove(e);
+	if (m_listener)
+		m_listener->descriptorRemoved(crc);
+	return len;
+}
+
+const __u8 *eEPGDescriptorStore::lookup(__u32 crc)
+{
+	shard &s = shardFor(crc);
+	singleLock l(s.lock);
+	return s.table ? s.find(crc)->descr : 0;
+}
+
+size_t eEPGDescriptorStore::size()
+{
+	size_t ret = 0;
+	for (int i = 0; i < SHARDS; ++i)
+	{
+		singleLock l(m_shard[i].lock);
+		ret += m_shard[i].used;
+	}
+	return ret;
+}
+
+size_t eEPGDescriptorStore::bytesAllocated()
+{
+	size_t ret = 0;
+	for (int i = 0; i < SHARDS; ++i)
+	{
+		singleLock l(m_shard[i].lock);
+		if (m_shard[i].table)
+			ret += (m_shard[i].mask + 1) * sizeof(entry);
+		ret += m_shard[i].alloc.bytesAllocated();
+	}
+	return ret;
+}
@@ -0,0 +1,105 @@
+#ifndef __lib_dvb_epgdescriptors_h
+#define __lib_dvb_epgdescriptors_h
+
+#include <pthread.h>
+#include <asm/types.h>
+#include <lib/base/elock.h>
+#include <lib/base/slaballoc.h>
+
+/**
+ * \brief Refcounted store for the EIT descriptors shared by cached events.
+ *
+ * Descriptors are keyed by their CRC32. The store is split into
+ * \c SHARDS independent open addressing hash tables (linear probing,
+ * backward shift deletion), selected by the upper bits of the CRC. Every
+ * shard has its own lock and slab allocator, so interning descriptors
+ * does not need eEPGCache::cache_lock and only rarely contends with
+ * readers on the same shard.
+ *
+ * Pointers returned by lookup() stay valid as long as the caller holds a
+ * reference to the descriptor, which is the case for every descriptor of
+ * an event still in the cache (i.e. with cache_lock held).
+ *
+ * Descriptors can also be stored \c external, i.e. without copying them
+ * (used for descriptors in a mapped epg.dat). The caller must keep the
+ * data alive until unref() reports that the last external reference is
+ * gone.
+ *
+ * A listener gets notified (with the shard lock held) whenever a
+ * descriptor is stored or released, e.g. to keep a search index.
+ */
+class eEPGDescriptorStore
+{
+public:
+	enum { SHARD_BITS = 4, SHARDS = 1 << SHARD_BITS };
+
+	struct listener
+	{
+		virtual ~listener() {}
+		virtual void descriptorAdded(__u32 crc, const __u8 *descr)=0;
+		virtual void descriptorRemoved(__u32 crc)=0;
+	};
+
+	eEPGDescriptorStore(listener *l=0);
+	~eEPGDescriptorStore();
+
+		/* adds a reference, copies the descriptor (or just keeps the
+		   pointer for external ones) when it is not stored yet.
+		   returns the number of newly stored bytes */
+	int ref(__u32 crc, const __u8 *descr, int refcount=1, bool external=false);
+		/* drops a reference. returns the number of freed bytes, or -1 when
+		   the crc is unknown. *external is incremented when an external
+		   descriptor was dropped */
+	int unref(__u32 crc, int *external=0);
+		/* returns the descriptor (tag, length, payload) or 0 */
+	const __u8 *lookup(__u32 crc);
+
+	size_t size();
+	size_t bytesAllocated();
+
+		/* calls bool f(__u32 crc, int refcount, const __u8 *descr) for each
+		   descriptor with the shard locked, until f returns false */
+	template <class F> void forEach(F &f)
+	{
+		for (int s = 0; s < SHARDS; ++s)
+		{
+			singleLock l(m_shard[s].lock);
+			for (unsigned int i = 0; m_shard[s].table && i <= m_shard[s].mask; ++i)
+			{
+				entry &e = m_shard[s].table[i];
+				if (e.descr && !f(e.crc, (int)(e.refcount & ~EXTERNAL), (const __u8*)e.descr))
+					return;
+			}
+		}
+	}
+private:
+	enum { EXTERNAL = 0x80000000 }; // flag in entry::refcount
+	struct entry
+	{
+		__u32 crc;
+		__u32 refcount;
+		__u8 *descr; // 0 for an empty slot
+	};
+	struct shard
+	{
+		pthread_mutex_t lock;
+		entry *table;
+		unsigned int mask, used;
+		eSlabAllocator alloc;
+		shard();
+		~shard();
+		entry *find(__u32 crc);
+		void grow();
+		void remove(entry *e);
+	};
+	shard m_shard[SHARDS];
+	listener *m_listener;
+
+	static unsigned int slot(__u32 crc) { return crc ^ (crc >> 16); }
+	shard &shardFor(__u32 crc) { return m_shard[crc >> (32 - SHARD_BITS)]; }
+
+	eEPGDescriptorStore(const eEPGDescriptorStore &);
+	eEPGDescriptorStore &operator=(const eEPGDescriptorStore &);
+};
+
+#endif
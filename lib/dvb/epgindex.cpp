@@ -0,0 +1,123 @@
+#include <lib/dvb/epgindex.h>
+#include <lib/base/elock.h>
+#include <algorithm>
+
+static inline __u32 fold(__u8 c)
+{
+	// like strncasecmp in the C locale
+	return (c >= 'A' && c <= 'Z') ? c + 'a' - 'A' : c;
+}
+
+eEPGTitleIndex::eEPGTitleIndex()
+	:m_removed(0)
+{
+	pthread_mutex_init(&m_lock, 0);
+}
+
+eEPGTitleIndex::~eEPGTitleIndex()
+{
+	pthread_mutex_destroy(&m_lock);
+}
+
+void eEPGTitleIndex::trigrams(const __u8 *data, int len, std::vector<__u32> &ret)
+{
+	ret.clear();
+	for (int i = 0; i + 3 <= len; ++i)
+		ret.push_back((fold(data[i]) << 16) | (fold(data[i+1]) << 8) | fold(data[i+2]));
+	std::sort(ret.begin(), ret.end());
+	ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
+}
+
+void eEPGTitleIndex::descriptorAdded(__u32 crc, const __u8 *descr)
+{
+	if (descr[0] != 0x4D) // short event descriptor
+		return;
+	int title_len = descr[5];
+	if (title_len > descr[1] - 4)
+		title_len = descr[1] - 4;
+	std::vector<__u32> tri;
+	trigrams(descr + 6, title_len, tri);
+
+	singleLock s(m_lock);
+	if (!m_titles.insert(crc).second)
+		return;
+	for (std::vector<__u32>::iterator it(tri.begin()); it != tri.end(); ++it)
+		m_postings[*it].push_back(crc);
+}
+
+void eEPGTitleIndex::descriptorRemoved(__u32 crc)
+{
+	singleLock s(m_lock);
+	if (m_titles.erase(crc))
+		++m_removed;
+}
+
+int eEPGTitleIndex::candidates(const char *str, int len, std::vector<__u32> &crcs)
+{
+	crcs.clear();
+	if (len < 3)
+		return -1;
+	std::vector<__u32> tri;
+	trigrams((const __u8*)str, len, tri);
+
+	singleLock s(m_lock);
+	const std::vector<__u32> *rarest = 0;
+	for (std::vector<__u32>::iterator it(tri.begin()); it != tri.end(); ++it)
+	{
+		__gnu_cxx::hash_map<__u32, std::vector<__u32> >::iterator p = m_postings.find(*it);
+		if (p == m_postings.end())
+			return 0;
+		if (!rarest || p->second.size() < rarest->size())
+			rarest = &p->second;
+	}
+	crcs.reserve(rarest->size());
+	for (std::vector<__u32>::const_iterator it(rarest->begin()); it != rarest->end(); ++it)
+		if (m_titles.find(*it) != m_titles.end())
+			crcs.push_back(*it);
+	// a descriptor released and stored again is listed twice
+	std::sort(crcs.begin(), crcs.end());
+	crcs.erase(std::unique(crcs.begin(), crcs.end()), crcs.end());
+	return 0;
+}
+
+void eEPGTitleIndex::compact()
+{
+	singleLock s(m_lock);
+	if (m_removed <= m_titles.size())
+		return;
+	for (__gnu_cxx::hash_map<__u32, std::vector<__u32> >::iterator it(m_postings.begin()); it != m_postings.end(); )
+	{
+		std::vector<__u32> &list = it->second;
+		std::sort(list.begin(), list.end());
+		list.erase(std::unique(list.begin(), list.end()), list.end());
+		size_t n = 0;
+		for (size_t i = 0; i < list.size(); ++i)
+			if (m_titles.find(list[i]) != m_titles.end())
+				list[n++] = list[i];
+		if (n)
+		{
+			list.resize(n);
+			std::vector<__u32>(list).swap(list); // shrink to fit
+			++it;
+		}
+		else
+			m_postings.erase(it++);
+	}
+	m_removed = 0;
+}
+
+size_t eEPGTitleIndex::titles()
+{
+	singleLock s(m_lock);
+	return m_titles.size();
+}
+
+size_t eEPGTitleIndex::memoryUsage()
+{
+	singleLock s(m_lock);
+	size_t ret = m_titles.bucket_count() * sizeof(void*) + m_titles.size() * 2 * sizeof(void*);
+	ret += m_postings.bucket_count() * sizeof(void*);
+	for (__gnu_cxx::hash_map<__u32, std::vector<__u32> >::iterator it(m_postings.begin()); it != m_postings.end(); ++it)
+		ret += 2 * sizeof(void*) + sizeof(std::vector<__u32>) + it->second.capacity() * sizeof(__u32);
+	return ret;
+}
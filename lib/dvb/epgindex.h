@@ -0,0 +1,53 @@
+#ifndef __lib_dvb_epgindex_h
+#define __lib_dvb_epgindex_h
+
+#include <pthread.h>
+#include <vector>
+#include <ext/hash_map>
+#include <ext/hash_set>
+#include <lib/dvb/epgdescriptors.h>
+
+/**
+ * \brief Trigram index over the titles of the cached short event descriptors.
+ *
+ * Every title is split into overlapping three byte sequences, folded to
+ * lower case. For each of them the index keeps the CRCs of the short
+ * event descriptors containing it, so a title search only needs to check
+ * the descriptors of the rarest trigram of the search string instead of
+ * all descriptors in the cache.
+ *
+ * The index is the listener of eventData::descriptors and is therefore
+ * updated together with the descriptor store, i.e. whenever sectionRead
+ * adds or cleanLoop removes events. Released descriptors are only
+ * dropped from the set of live titles, their postings are removed by
+ * compact().
+ */
+class eEPGTitleIndex: public eEPGDescriptorStore::listener
+{
+public:
+	eEPGTitleIndex();
+	~eEPGTitleIndex();
+
+	void descriptorAdded(__u32 crc, const __u8 *descr);
+	void descriptorRemoved(__u32 crc);
+
+		/* fills crcs with the short event descriptors which might contain
+		   str in their title (ignoring case). the caller must check the
+		   titles. returns -1 when str is too short for the index */
+	int candidates(const char *str, int len, std::vector<__u32> &crcs);
+		/* removes the postings of released descriptors, when there are
+		   more of them than live titles */
+	void compact();
+
+	size_t titles();
+	size_t memoryUsage();
+private:
+	pthread_mutex_t m_lock;
+	__gnu_cxx::hash_map<__u32, std::vector<__u32> > m_postings;
+	__gnu_cxx::hash_set<__u32> m_titles;
+	size_t m_removed;
+
+	static void trigrams(const __u8 *data, int len, std::vector<__u32> &ret);
+};
+
+#endif
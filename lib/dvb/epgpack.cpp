@@ -0,0 +1,85 @@
+#include <lib/dvb/epgpack.h>
+#include <lib/dvb/epgcache.h>
+#include <lib/service/event.h>
+#include <string.h>
+
+eEPGPackedResult::eEPGPackedResult(int services, int events)
+{
+	m_first.reserve(services + 1);
+	m_begin.reserve(events);
+	m_duration.reserve(events);
+	m_string.reserve(2 * events + 1);
+	m_event_id.reserve(events);
+	m_tsidonid.reserve(events);
+	m_raw_offset.reserve(events);
+	m_raw.reserve(events * 128);
+	m_string.push_back(0);
+}
+
+void eEPGPackedResult::addService()
+{
+	m_first.push_back(m_begin.size());
+}
+
+void eEPGPackedResult::addEvent(eventData *event, int tsidonid)
+{
+	const eit_event_struct *e = event->get();
+	const __u8 *data = (const __u8*)e;
+	int len = 12 + ((data[10] & 0x0F) << 8 | data[11]);
+	m_begin.push_back(event->getStartTime());
+	m_duration.push_back(event->getDuration());
+	m_event_id.push_back(event->getEventID());
+	m_tsidonid.push_back(tsidonid);
+	m_raw_offset.push_back(m_raw.size());
+	m_raw.insert(m_raw.end(), data, data + len);
+}
+
+void eEPGPackedResult::decodeStrings()
+{
+	m_strings.clear();
+	m_string.resize(1);
+	for (size_t i = 0; i < m_raw_offset.size(); ++i)
+	{
+		Event ev(&m_raw[m_raw_offset[i]]);
+		eServiceEvent evt;
+		evt.parseFrom(&ev, m_tsidonid[i]);
+		m_strings += evt.getEventName();
+		m_string.push_back(m_strings.size());
+		m_strings += evt.getShortDescription();
+		m_string.push_back(m_strings.size());
+	}
+}
+
+template <class T>
+static inline char *put(char *dst, const std::vector<T> &v)
+{
+	if (!v.empty())
+		memcpy(dst, &v[0], v.size() * sizeof(T));
+	return dst + v.size() * sizeof(T);
+}
+
+void eEPGPackedResult::finish(std::string &out)
+{
+	decodeStrings();
+
+	header hdr;
+	hdr.service_count = m_first.size();
+	hdr.event_count = m_begin.size();
+	hdr.strings_size = m_strings.size();
+	hdr.reserved = 0;
+	m_first.push_back(m_begin.size());
+
+	size_t ids = (m_event_id.size() * sizeof(__u16) + 3) & ~3;
+	out.resize(sizeof(header) + (m_first.size() + m_begin.size() + m_duration.size() + m_string.size()) * sizeof(__u32) + ids + m_strings.size());
+	char *p = &out[0];
+	memcpy(p, &hdr, sizeof(header));
+	p += sizeof(header);
+	p = put(p, m_first);
+	p = put(p, m_begin);
+	p = put(p, m_duration);
+	p = put(p, m_string);
+	memset(put(p, m_event_id), 0, ids - m_event_id.size() * sizeof(__u16));
+	p += ids;
+	memcpy(p, m_strings.data(), m_strings.size());
+	m_first.pop_back();
+}
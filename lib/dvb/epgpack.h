@@ -0,0 +1,60 @@
+#ifndef __lib_dvb_epgpack_h
+#define __lib_dvb_epgpack_h
+
+#include <vector>
+#include <string>
+#include <asm/types.h>
+
+class eventData;
+
+/**
+ * \brief Packs the events of several services into one flat buffer.
+ *
+ * Used by eEPGCache::lookupEventsPacked to return the events of a whole
+ * EPG grid at once instead of a python tuple per event. The buffer holds
+ * the fields as struct of arrays in native byte order, so a renderer can
+ * slice the columns it needs (e.g. with the array module) and decode the
+ * strings of the visible events only:
+ *
+ *   __u32 service_count, event_count, strings_size, reserved
+ *   __u32 first_event[service_count + 1]  events of service n are
+ *                                         first_event[n] .. first_event[n+1]-1
+ *   __u32 begin[event_count]
+ *   __u32 duration[event_count]
+ *   __u32 string[2 * event_count + 1]     offsets into the string table, the
+ *                                         title of event n is string[2n] ..
+ *                                         string[2n+1], the short description
+ *                                         string[2n+1] .. string[2n+2]
+ *   __u16 event_id[event_count]           padded to a multiple of 4 bytes
+ *   char strings[strings_size]            utf-8, not terminated
+ */
+class eEPGPackedResult
+{
+public:
+	struct header
+	{
+		__u32 service_count, event_count, strings_size, reserved;
+	};
+
+	eEPGPackedResult(int services=0, int events=0);
+
+		/* starts the next service, the following events belong to it */
+	void addService();
+		/* eventData is only valid with eEPGCache::cache_lock held, the raw
+		   event is copied and decoded later by finish() */
+	void addEvent(eventData *event, int tsidonid);
+		/* decodes the strings, called without cache_lock */
+	void finish(std::string &out);
+
+	int events() const { return m_begin.size(); }
+private:
+	void decodeStrings();
+	std::vector<__u32> m_first, m_begin, m_duration, m_string;
+	std::vector<__u16> m_event_id;
+	std::vector<int> m_tsidonid;
+	std::vector<__u32> m_raw_offset;
+	std::vector<__u8> m_raw;
+	std::string m_strings;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include <lib/dvb/epgwriter.h>
+#include <lib/base/ioprio.h>
+#include <lib/base/eerror.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+eEPGCacheWriter::eEPGCacheWriter(eMainloop *context)
+	:messages(this,1), replaced(context,1)
+{
+	CONNECT(messages.recv_msg, eEPGCacheWriter::gotMessage);
+	run();
+}
+
+eEPGCacheWriter::~eEPGCacheWriter()
+{
+	messages.send(Message(Message::quit));
+	kill(); // waiting for thread shutdown
+}
+
+void eEPGCacheWriter::thread()
+{
+	hasStarted();
+
+	nice(5);
+
+	setIoPrio(IOPRIO_CLASS_BE, 7);
+
+	runLoop();
+}
+
+void eEPGCacheWriter::append(const char *filename, std::vector<__u8> *data)
+{
+	messages.send(Message(Message::append, strdup(filename), data));
+}
+
+void eEPGCacheWriter::create(const char *filename, std::vector<__u8> *data)
+{
+	messages.send(Message(Message::create, strdup(filename), data));
+}
+
+void eEPGCacheWriter::replace(const char *filename, std::vector<__u8> *data, int id)
+{
+	messages.send(Message(Message::replace, strdup(filename), data, id));
+}
+
+int eEPGCacheWriter::writeFile(const char *filename, int flags, const std::vector<__u8> &data)
+{
+	int fd = ::open(filename, O_WRONLY | O_CREAT | flags, 0644);
+	if (fd < 0)
+	{
+		eDebug("[eEPGCacheWriter] open %s failed (%m)", filename);
+		return -1;
+	}
+	size_t pos = 0;
+	while (pos < data.size())
+	{
+		ssize_t wr = ::write(fd, &data[pos], data.size() - pos);
+		if (wr < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			eDebug("[eEPGCacheWriter] write %s failed (%m)", filename);
+			::close(fd);
+			return -1;
+		}
+		pos += wr;
+	}
+	if (fdatasync(fd) < 0)
+		eDebug("[eEPGCacheWriter] fdatasync %s failed (%m)", filename);
+	::close(fd);
+	return 0;
+}
+
+void eEPGCacheWriter::gotMessage(const Message &msg)
+{
+	switch (msg.type)
+	{
+		case Message::append:
+			writeFile(msg.filename, O_APPEND, *msg.data);
+			break;
+		case Message::create:
+			writeFile(msg.filename, O_TRUNC, *msg.data);
+			break;
+		case Message::replace:
+		{
+			char tmp[1040];
+			int error = 0;
+			snprintf(tmp, sizeof(tmp), "%s.tmp", msg.filename);
+			if (writeFile(tmp, O_TRUNC, *msg.data))
+			{
+				::unlink(tmp);
+				error = -1;
+			}
+			else if (::rename(tmp, msg.filename) < 0)
+			{
+				eDebug("[eEPGCacheWriter] rename %s to %s failed (%m)", tmp, msg.filename);
+				::unlink(tmp);
+				error = -1;
+			}
+			else
+				eDebug("[eEPGCacheWriter] %zu bytes written to %s", msg.data->size(), msg.filename);
+			replaced.send(Result(msg.id, error));
+			break;
+		}
+		case Message::quit:
+			quit(0);
+			break;
+		default:
+			eDebug("unhandled eEPGCacheWriter Message!!");
+			break;
+	}
+	free(msg.filename);
+	delete msg.data;
+}
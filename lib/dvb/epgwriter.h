@@ -0,0 +1,64 @@
+#ifndef __lib_dvb_epgwriter_h
+#define __lib_dvb_epgwriter_h
+
+#include <vector>
+#include <asm/types.h>
+#include <lib/base/thread.h>
+#include <lib/base/message.h>
+#include <lib/base/ebase.h>
+
+/**
+ * \brief Background writer for EPG cache files.
+ *
+ * eEPGCache serializes snapshots and journal records into memory with
+ * cache_lock held, the (slow) file io is done in this thread with a low
+ * io priority. Jobs are written in the order they were queued.
+ */
+class eEPGCacheWriter: public eMainloop, private eThread, public Object
+{
+	struct Message
+	{
+		int type;
+		char *filename;
+		std::vector<__u8> *data;
+		int id;
+		enum
+		{
+			append,
+			create,
+			replace,
+			quit
+		};
+		Message(int type=0, char *filename=0, std::vector<__u8> *data=0, int id=0)
+			:type(type), filename(filename), data(data), id(id)
+		{}
+	};
+	eFixedMessagePump<Message> messages;
+	void gotMessage(const Message &message);
+	void thread();
+	int writeFile(const char *filename, int flags, const std::vector<__u8> &data);
+public:
+	struct Result
+	{
+		int id;
+		int error; // 0 when the file was written and renamed
+		Result(int id=0, int error=0)
+			:id(id), error(error)
+		{}
+	};
+		/* the result of each replace job, received in the context mainloop */
+	eFixedMessagePump<Result> replaced;
+
+	eEPGCacheWriter(eMainloop *context);
+		/* returns when all queued data is written */
+	~eEPGCacheWriter();
+
+		/* all of them take the ownership of data */
+	void append(const char *filename, std::vector<__u8> *data);
+	void create(const char *filename, std::vector<__u8> *data);
+		/* writes a temporary file and renames it to filename when it is
+		   completely on disk */
+	void replace(const char *filename, std::vector<__u8> *data, int id);
+};
+
+#endif
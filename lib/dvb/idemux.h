@@ -41,6 +41,13 @@ public:
 	virtual RESULT enableAccessPoints(bool enable) = 0;
 	virtual RESULT setBoundary(off_t max) = 0;
 	virtual RESULT setTimeshift(bool enable) = 0;
+		/* mode and buffersize as in eFilePushThread::setWriteMode */
+	virtual RESULT setWriteMode(int mode, int buffersize) = 0;
+		/* as in eFilePushThread::setPreallocation */
+	virtual RESULT setPreallocation(int bitrate, int duration) = 0;
+		/* record through the demux reader shared by the recordings which
+		   enable it, instead of an own demux fd. Off by default. */
+	virtual RESULT setShareDemux(bool enable) = 0;
 	
 	virtual RESULT stop() = 0;
 
@@ -54,6 +61,10 @@ public:
 		eventReachedBoundary,
 				/* the programmed boundary was reached. you might set a new target fd. you can close the */
 				/* old one. */
+		eventParserOverflow,
+				/* the .ap/.sc parser couldn't keep up, data was recorded but not indexed. */
+		eventParserLag,
+				/* the .ap/.sc parser is more than half of its buffer behind the recording. */
 	};
 	virtual RESULT connectEvent(const Slot1<void,int> &event, ePtr<eConnection> &conn)=0;
 };
@@ -34,7 +34,8 @@ struct eDVBSectionFilterMask
 	__u8 data[DMX_FILTER_SIZE], mask[DMX_FILTER_SIZE], mode[DMX_FILTER_SIZE];
 	enum {
 		rfCRC=1,
-		rfNoAbort=2
+		rfNoAbort=2,
+		rfDeferCRC=4 // rfCRC without the software check in the reader, the client has to check it
 	};
 	int flags;
 };
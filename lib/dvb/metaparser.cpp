@@ -1,6 +1,10 @@
 #include <lib/dvb/metaparser.h>
 #include <lib/base/eerror.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
 
 eDVBMetaParser::eDVBMetaParser()
 {
@@ -9,6 +13,7 @@ eDVBMetaParser::eDVBMetaParser()
 	m_length = 0;
 	m_filesize = 0;
 	m_scrambled = 0;
+	m_extents = 0;
 }
 
 int eDVBMetaParser::parseFile(const std::string &basename)
@@ -45,6 +50,22 @@ long long eDVBMetaParser::fileSize(const std::string &basename)
 	return filesize;
 }
 
+int eDVBMetaParser::fileExtents(const std::string &basename)
+{
+	int fd = ::open(basename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return -1;
+		/* without room for extents, FIEMAP only counts them. no
+		   FIEMAP_FLAG_SYNC, flushing a whole recording would stall the
+		   other recordings, data not written yet is not counted */
+	struct fiemap fm;
+	memset(&fm, 0, sizeof(fm));
+	fm.fm_length = FIEMAP_MAX_OFFSET;
+	int extents = ::ioctl(fd, FS_IOC_FIEMAP, &fm) < 0 ? -1 : (int)fm.fm_mapped_extents;
+	::close(fd);
+	return extents;
+}
+
 int eDVBMetaParser::parseMeta(const std::string &tsname)
 {
 		/* if it's a PVR channel, recover service id. */
@@ -57,6 +78,7 @@ int eDVBMetaParser::parseMeta(const std::string &tsname)
 	int linecnt = 0;
 	
 	m_time_create = 0;
+	m_extents = 0;
 	
 	while (1)
 	{
@@ -98,6 +120,9 @@ int eDVBMetaParser::parseMeta(const std::string &tsname)
 		case 8:
 			m_scrambled = atoi(line);
 			break;
+		case 9:
+			m_extents = atoi(line);
+			break;
 		default:
 			break;
 		}
@@ -177,6 +202,8 @@ int eDVBMetaParser::updateMeta(const std::string &tsname)
 	if (!f)
 		return -ENOENT;
 	fprintf(f, "%s\n%s\n%s\n%d\n%s\n%d\n%lld\n%s\n%d\n", ref.toString().c_str(), m_name.c_str(), m_description.c_str(), m_time_create, m_tags.c_str(), m_length, m_filesize, m_service_data.c_str(), m_scrambled);
+	if (m_extents > 0)
+		fprintf(f, "%d\n", m_extents);
 	fclose(f);
 	return 0;
 }
@@ -13,11 +13,14 @@ public:
 	int parseRecordings(const std::string &filename);
 	int updateMeta(const std::string &basename);
 	long long fileSize(const std::string &basename);
+		/* the number of extents of the file, -1 when unknown */
+	int fileExtents(const std::string &basename);
 
 	eServiceReferenceDVB m_ref;
 	int m_data_ok, m_time_create, m_length, m_scrambled;
 	std::string m_name, m_description, m_tags, m_service_data;
 	long long m_filesize;
+	int m_extents; // fragmentation of the recording, 0 when not measured
 };
 
 #endif
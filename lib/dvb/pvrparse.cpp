@@ -811,6 +811,12 @@ void eMPEGStreamParserTS::setPid(int _pid, int type)
 	m_streamtype = type;
 }
 
+void eMPEGStreamParserTS::resync()
+{
+	m_pktptr = 0;
+	m_need_next_packet = 0;
+}
+
 int eMPEGStreamParserTS::getLastPTS(pts_t &last_pts)
 {
 	if (!m_last_pts_valid)
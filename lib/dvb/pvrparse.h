@@ -82,6 +82,8 @@ public:
 	void setPid(int pid, int streamtype);
 	int getLastPTS(pts_t &last_pts);
 	void enableAccessPoints(bool enable) { m_enable_accesspoints = enable; }
+		/* forget the partial packet, the next data doesn't follow the last one */
+	void resync();
 private:
 	eMPEGStreamInformation &m_streaminfo;
 	unsigned char m_pkt[188];
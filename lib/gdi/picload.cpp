@@ -549,13 +549,31 @@ ERROR_R:
 
 //---------------------------------------------------------------------------------------------
 
+class ePicLoad::decodeJob: public eThreadPool::job
+{
+	ePicLoad *m_picload;
+	int m_what;
+public:
+	decodeJob(ePicLoad *picload, int what)
+		:m_picload(picload), m_what(what)
+	{
+	}
+	void run()
+	{
+		if (m_what == 1)
+			m_picload->decodePic();
+		else
+			m_picload->decodeThumb();
+	}
+	void finished()
+	{
+		m_picload->decodeFinished();
+	}
+};
+
 ePicLoad::ePicLoad()
-	:msg_thread(this,1), msg_main(eApp,1)
 {
-	CONNECT(msg_thread.recv_msg, ePicLoad::gotMessage);
-	CONNECT(msg_main.recv_msg, ePicLoad::gotMessage);
-	
-	threadrunning = false;
+	m_job = NULL;
 	m_filepara = NULL;
 	m_conf.max_x = 0;
 	m_conf.max_y = 0;
@@ -568,31 +586,21 @@ ePicLoad::ePicLoad()
 
 void ePicLoad::waitFinished()
 {
-	msg_thread.send(Message(Message::quit));
-	kill();
+	if (m_job)
+	{
+			/* waits for a running decode, the result is dropped */
+		eThreadPool::getInstance()->cancel(m_job);
+		m_job = NULL;
+	}
 }
 
 ePicLoad::~ePicLoad()
 {
-	if (threadrunning)
-		waitFinished();
+	waitFinished();
 	if(m_filepara != NULL)
 		delete m_filepara;
 }
 
-void ePicLoad::thread_finished()
-{
-	threadrunning=false;
-}
-
-void ePicLoad::thread()
-{
-	hasStarted();
-	threadrunning=true;
-	nice(4);
-	runLoop();
-}
-
 void ePicLoad::decodePic()
 {
 	eDebug("[Picload] decode picture... %s",m_filepara->file);
@@ -748,45 +756,27 @@ void ePicLoad::resizePic()
 	m_filepara->oy = imy;
 }
 
-void ePicLoad::gotMessage(const Message &msg)
+void ePicLoad::decodeFinished() // called from main thread
 {
-	switch (msg.type)
+	m_job = NULL;
+	//eDebug("[Picload] decode finished... %s", m_filepara->file);
+	if(m_filepara->callback)
 	{
-		case Message::decode_Pic:
-			decodePic();
-			msg_main.send(Message(Message::decode_finished));
-			break;
-		case Message::decode_Thumb:
-			decodeThumb();
-			msg_main.send(Message(Message::decode_finished));
-			break;
-		case Message::quit: // called from decode thread
-			eDebug("[Picload] decode thread ... got quit msg");
-			quit(0);
-			break;
-		case Message::decode_finished: // called from main thread
-			//eDebug("[Picload] decode finished... %s", m_filepara->file);
-			if(m_filepara->callback)
-			{
-				PictureData(m_filepara->picinfo.c_str());
-			}
-			else
-			{
-				if(m_filepara != NULL)
-				{
-					delete m_filepara;
-					m_filepara = NULL;
-				}
-			}
-			break;
-		default:
-			eDebug("unhandled thread message");
+		PictureData(m_filepara->picinfo.c_str());
+	}
+	else
+	{
+		if(m_filepara != NULL)
+		{
+			delete m_filepara;
+			m_filepara = NULL;
+		}
 	}
 }
 
 int ePicLoad::startThread(int what, const char *file, int x, int y, bool async)
 {
-	if(async && threadrunning && m_filepara != NULL)
+	if(async && m_job && m_filepara != NULL)
 	{
 		eDebug("[Picload] thread running");
 		m_filepara->callback = false;
@@ -831,11 +821,8 @@ int ePicLoad::startThread(int what, const char *file, int x, int y, bool async)
 	}
 	
 	if (async) {
-		if(what==1)
-			msg_thread.send(Message(Message::decode_Pic));
-		else
-			msg_thread.send(Message(Message::decode_Thumb));
-		run();
+		m_job = new decodeJob(this, what);
+		eThreadPool::getInstance()->queue(m_job, eThreadPool::prioNormal, eApp);
 	}
 	else if (what == 1)
 		decodePic();
@@ -2,10 +2,8 @@
 #define __picload_h__
 
 #include <lib/gdi/gpixmap.h>
-#include <lib/base/thread.h>
 #include <lib/python/python.h>
-#include <lib/base/message.h>
-#include <lib/base/ebase.h>
+#include <lib/base/threadpool.h>
 
 #ifndef SWIG
 class Cfilepara
@@ -44,7 +42,7 @@ public:
 };
 #endif
 
-class ePicLoad: public eMainloop, public eThread, public Object, public iObject
+class ePicLoad: public iObject
 {
 	DECLARE_REF(ePicLoad);
 
@@ -55,7 +53,11 @@ class ePicLoad: public eMainloop, public eThread, public Object, public iObject
 	void resizePic();
 
 	Cfilepara *m_filepara;
-	bool threadrunning;
+
+		/* decodes in the thread pool, m_job is set while it runs */
+	class decodeJob;
+	friend class decodeJob;
+	decodeJob *m_job;
 	
 	struct PConf
 	{
@@ -69,25 +71,8 @@ class ePicLoad: public eMainloop, public eThread, public Object, public iObject
 		int test;
 	} m_conf;
 	
-	struct Message
-	{
-		int type;
-		enum
-		{
-			decode_Pic,
-			decode_Thumb,
-			decode_finished,
-			quit
-		};
-		Message(int type=0)
-			:type(type) {}
-	};
-	eFixedMessagePump<Message> msg_thread, msg_main;
-
-	void gotMessage(const Message &message);
-	void thread();
+	void decodeFinished();
 	int startThread(int what, const char *file, int x, int y, bool async=true);
-	void thread_finished();
 public:
 	void waitFinished();
 	PSignal1<void, const char*> PictureData;
@@ -13,4 +13,25 @@ def InitRecordingConfig():
 		("short", _("Short filenames")),
 		("long", _("Long filenames")) ] )
 	config.recording.always_ecm = ConfigYesNo(default = False)
-	config.recording.never_decrypt = ConfigYesNo(default = False)
\ No newline at end of file
+	config.recording.never_decrypt = ConfigYesNo(default = False)
+	# the values are the modes of eFilePushThread::setWriteMode
+	config.recording.write_mode = ConfigSelection(default = "0", choices = [
+		("0", _("page cache")),
+		("1", _("write behind")),
+		("2", _("direct I/O")) ] )
+	config.recording.write_buffer = ConfigSelection(default = "0", choices = [
+		("0", _("automatic")),
+		("1", "1 MB"),
+		("2", "2 MB"),
+		("4", "4 MB"),
+		("8", "8 MB") ] )
+	# the expected bitrate in Mbit/s, the space for the recording is reserved in chunks from it.
+	# off by default, space reserved beyond the end of a recording stays allocated when enigma2 crashes
+	config.recording.preallocate = ConfigSelection(default = "0", choices = [
+		("0", _("no")),
+		("4", "4 Mbit/s"),
+		("8", "8 Mbit/s"),
+		("16", "16 Mbit/s"),
+		("24", "24 Mbit/s") ] )
+	# the recordings of a demux read it through one shared demux fd, see eDVBRecordMux
+	config.recording.share_demux = ConfigYesNo(default = False)
\ No newline at end of file
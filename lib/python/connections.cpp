@@ -1,4 +1,5 @@
 #include <lib/python/connections.h>
+#include <lib/base/loopprofile.h>
 
 PSignal::PSignal()
 {
@@ -11,6 +12,10 @@ PSignal::~PSignal()
 
 void PSignal::callPython(ePyObject tuple)
 {
+	bool profile = eMainloopProfile::enabled;
+	timespec start;
+	if (profile)
+		clock_gettime(CLOCK_MONOTONIC, &start);
 	int size = PyList_Size(m_list);
 	int i;
 	for (i=0; i<size; ++i)
@@ -18,6 +23,8 @@ void PSignal::callPython(ePyObject tuple)
 		ePyObject b = PyList_GET_ITEM(m_list, i);
 		ePython::call(b, tuple);
 	}
+	if (profile)
+		eMainloopProfile::addPython(start);
 }
 
 PyObject *PSignal::get()
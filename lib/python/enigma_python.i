@@ -37,6 +37,7 @@ is usually caused by not marking PSignals as immutable.
 
 #define SWIG_COMPILE
 #include <lib/base/ebase.h>
+#include <lib/base/loopprofile.h>
 #include <lib/base/smartptr.h>
 #include <lib/base/eenv.h>
 #include <lib/base/eerror.h>
@@ -142,6 +143,7 @@ typedef long time_t;
 
 %immutable eSocketNotifier::activated;
 %include <lib/base/ebase.h>
+%include <lib/base/loopprofile.h>
 %include <lib/base/smartptr.h>
 %include <lib/service/event.h>
 %include <lib/service/iservice.h>
@@ -52,6 +52,7 @@ public:
 	RESULT parseFrom(Event *evt, int tsidonid=0);
 	RESULT parseFrom(const std::string filename, int tsidonid=0);
 	static void setEPGLanguage( const std::string language );
+	static const std::string &getEPGLanguage() { return m_language; }
 #endif
 	time_t getBeginTime() const { return m_begin; }
 	int getDuration() const { return m_duration; }
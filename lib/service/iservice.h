@@ -904,6 +904,8 @@ public:
 		evTuneStart,
 		evPvrTuneStart,
 		evPvrEof,
+		evRecordParserOverflow,
+		evRecordParserLag,
 	};
 	enum {
 		NoError=0,
@@ -31,6 +31,7 @@ eDVBServiceRecord::eDVBServiceRecord(const eServiceReferenceDVB &ref, bool isstr
 	m_target_fd = -1;
 	m_error = 0;
 	m_streaming = 0;
+	m_duration = 0;
 	m_simulate = false;
 	m_last_event_id = -1;
 	m_serviceType = eDVBServicePMTHandler::recording;
@@ -112,6 +113,7 @@ RESULT eDVBServiceRecord::prepare(const char *filename, time_t begTime, time_t e
 	bool config_recording_never_decrypt = ePythonConfigQuery::getConfigBoolValue("config.recording.never_decrypt", false);
 	m_filename = filename;
 	m_streaming = 0;
+	m_duration = (begTime != -1 && endTime > begTime) ? endTime - begTime : 0;
 	m_descramble = config_recording_never_decrypt ? false : descramble;
 	m_record_ecm = config_recording_always_ecm ? true : recordecm;
 
@@ -219,6 +221,7 @@ RESULT eDVBServiceRecord::prepareStreaming()
 {
 	m_filename = "";
 	m_streaming = 1;
+	m_duration = 0;
 	if (m_state == stateIdle)
 		return doPrepare();
 	return -1;
@@ -245,6 +248,17 @@ RESULT eDVBServiceRecord::stop()
 		{
 			::close(m_target_fd);
 			m_target_fd = -1;
+
+				/* keep the fragmentation of the recording for later analysis */
+			eDVBMetaParser meta;
+			int extents = meta.fileExtents(m_filename);
+			if (extents > 0 && !meta.parseMeta(m_filename))
+			{
+				meta.m_extents = extents;
+				long long size = meta.fileSize(m_filename);
+				eDebug("recording %s: %lldMB in %d extents", m_filename.c_str(), size >> 20, extents);
+				meta.updateMeta(m_filename);
+			}
 		}
 		
 		saveCutlist();
@@ -389,6 +403,11 @@ int eDVBServiceRecord::doRecord()
 		}
 		m_record->setTargetFD(fd);
 		m_record->setTargetFilename(m_filename.c_str());
+		m_record->setWriteMode(ePythonConfigQuery::getConfigIntValue("config.recording.write_mode", 0),
+			ePythonConfigQuery::getConfigIntValue("config.recording.write_buffer", 0) * 1024 * 1024);
+		m_record->setPreallocation(ePythonConfigQuery::getConfigIntValue("config.recording.preallocate", 0) * 1000,
+			m_duration);
+		m_record->setShareDemux(ePythonConfigQuery::getConfigBoolValue("config.recording.share_demux"));
 		m_record->connectEvent(slot(*this, &eDVBServiceRecord::recordEvent), m_con_record_event);
 
 		m_target_fd = fd;
@@ -679,6 +698,13 @@ void eDVBServiceRecord::recordEvent(int event)
 		stop();
 		m_event((iRecordableService*)this, evRecordWriteError);
 		return;
+	case iDVBTSRecorder::eventParserOverflow:
+		eWarning("[eDVBServiceRecord] record index incomplete");
+		m_event((iRecordableService*)this, evRecordParserOverflow);
+		return;
+	case iDVBTSRecorder::eventParserLag:
+		m_event((iRecordableService*)this, evRecordParserLag);
+		return;
 	default:
 		eDebug("unhandled record event %d", event);
 	}
@@ -67,6 +67,7 @@ private:
 	std::map<int,pts_t> m_event_timestamps;
 	int m_target_fd;
 	int m_streaming;
+	int m_duration; // of the timer in seconds, 0 when unknown
 	int m_last_event_id;
 	
 	int doPrepare();
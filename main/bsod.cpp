@@ -1,6 +1,8 @@
 #include <csignal>
 #include <fstream>
 #include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
 #include <lib/base/eenv.h>
 #include <lib/base/eerror.h>
 #include <lib/base/nconfig.h>
@@ -119,6 +121,16 @@ void bsodFatal(const char *component)
 	os << time(0);
 
 	std::string logfile("/media/hdd/enigma2_crash_" + os.str() + ".log");
+	std::string dumpfile("/media/hdd/enigma2_crash_" + os.str() + ".logdump");
+
+		/* the raw log rings first, they don't need the writer thread */
+	int fd = open(dumpfile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd >= 0)
+	{
+		eLogCrashdump(fd);
+		close(fd);
+	}
+	eLogFlush(true);
 
 	FILE *f = fopen(logfile.c_str(), "wb");
 	
@@ -211,6 +223,8 @@ void bsodFatal(const char *component)
 
 		xml.open("crashlogs");
 		xml.cDataFromString("enigma2crashlog", getLogBuffer());
+		if (fd >= 0)
+			xml.string("enigma2logdump", dumpfile);
 		xml.cDataFromCmd("pythonMD5sum", "find " + eEnv::resolve("${libdir}/enigma2/python/") + " -name \"*.py\" | xargs md5sum");
 		xml.close();
 
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <malloc.h>
+#include <lib/base/ebase.h>
+#include <lib/base/eerror.h>
+#include <lib/gui/ewidgetdesktop.h>
+
+/*
+ * The functions enigma.cpp provides to the libraries, for the bench
+ * programs which link the libraries without the gui and the mainloop of
+ * enigma2. There is no desktop, quitMainloop only stops eApp when one
+ * was created by the program.
+ */
+
+#ifdef OBJECT_DEBUG
+int object_total_remaining;
+
+void object_dump()
+{
+	printf("%d items left\n", object_total_remaining);
+}
+#endif
+
+int getPrevAsciiCode()
+{
+	return 0;
+}
+
+int exit_code;
+
+void quitMainloop(int exitCode)
+{
+	exit_code = exitCode;
+	if (eApp)
+		eApp->quit(0);
+}
+
+eWidgetDesktop *getDesktop(int which)
+{
+	return 0;
+}
+
+eApplication *getApplication()
+{
+	return eApp;
+}
+
+void runMainloop()
+{
+	if (eApp)
+		eApp->runLoop();
+}
+
+const char *getEnigmaVersionString()
+{
+	return "bench";
+}
+
+void dump_malloc_stats(void)
+{
+	struct mallinfo mi = mallinfo();
+	eDebug("MALLOC: %d total", mi.uordblks);
+}
+
+void setAnimation_current(int a) {}
+void setAnimation_speed(int speed) {}
+void setAnimation_current_listbox(int a) {}
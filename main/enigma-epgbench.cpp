@@ -0,0 +1,391 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <vector>
+#include <map>
+#include <string>
+#include <lib/dvb/epgcache.h>
+#include <lib/dvb/epgdescriptors.h>
+#include <lib/dvb/epgpack.h>
+#include <lib/service/event.h>
+#include <lib/dvb/lowlevel/eit.h>
+#include <lib/dvb/crc32.h>
+#include <lib/dvb/dvbtime.h>
+#include <lib/base/estring.h>
+
+/*
+ * EIT ingestion benchmark for the EPG cache, the descriptor store and
+ * the packed multi service lookup. It runs without frontend and demux,
+ * so it can be used on any linux host.
+ *
+ * usage: enigma-epgbench <eit dump> [passes]
+ *
+ * The text benchmark converts the titles and descriptions of the short
+ * and extended event descriptors with convertDVBUTF8.
+ *
+ * The dump is a plain concatenation of EIT sections like they are read
+ * from a section filter on pid 0x12, e.g. recorded with
+ * dvbsnoop -b -n 20000 -s sec 0x12 > eit.bin
+ */
+
+static double now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct eitEvent
+{
+	eit_event_struct *data;
+	int size;
+	int sid;
+};
+
+static std::vector<eitEvent> events;
+static std::vector<__u8*> sections;
+static std::vector<__u32> crcs;
+static std::vector<const __u8*> crc_descr;
+
+static int readDump(const char *filename, std::vector<__u8> &dump)
+{
+	FILE *f = fopen(filename, "r");
+	if (!f)
+	{
+		printf("couldn't open %s (%m)\n", filename);
+		return -1;
+	}
+	__u8 buf[65536];
+	size_t rd;
+	while ((rd = fread(buf, 1, sizeof(buf), f)) > 0)
+		dump.insert(dump.end(), buf, buf + rd);
+	fclose(f);
+	return 0;
+}
+
+static void splitSections(std::vector<__u8> &dump)
+{
+	size_t pos = 0;
+	while (pos + 3 <= dump.size())
+	{
+		__u8 *data = &dump[pos];
+		size_t section_size = (((data[1] & 0x0F) << 8) | data[2]) + 3;
+		if (pos + section_size > dump.size())
+			break;
+		pos += section_size;
+		if (data[0] < 0x4E || data[0] > 0x6F)
+			continue;
+		sections.push_back(data);
+		int len = section_size - 4; // without crc
+		int ptr = EIT_SIZE;
+		while (ptr + EIT_LOOP_SIZE <= len)
+		{
+			eit_event_struct *e = (eit_event_struct*)(data + ptr);
+			eitEvent ev;
+			ev.data = e;
+			ev.size = HILO(e->descriptors_loop_length) + EIT_LOOP_SIZE;
+			ev.sid = (data[3] << 8) | data[4];
+			if (ptr + ev.size > len)
+				break;
+			events.push_back(ev);
+
+			int dptr = ptr + EIT_LOOP_SIZE;
+			while (dptr + 2 <= ptr + ev.size)
+			{
+				int dlen = data[dptr + 1] + 2;
+				crcs.push_back(crc32(0, data + dptr, dlen));
+				crc_descr.push_back(data + dptr);
+				dptr += dlen;
+			}
+			ptr += ev.size;
+		}
+	}
+	printf("%zu eit sections, %zu events, %zu descriptors\n", sections.size(), events.size(), crcs.size());
+}
+
+	/* the cache only takes events of the next 14 days, so the recorded
+	   events are moved by whole days to start today */
+static void shiftTimes()
+{
+	time_t first = -1;
+	for (size_t i = 0; i < events.size(); ++i)
+	{
+		eit_event_struct *e = events[i].data;
+		time_t t = parseDVBtime(e->start_time_1, e->start_time_2, e->start_time_3, e->start_time_4, e->start_time_5);
+		if (t != 3599 && (first == -1 || t < first))
+			first = t;
+	}
+	time_t shift = (::time(0) - first) / 86400 * 86400;
+	for (size_t i = 0; i < events.size(); ++i)
+	{
+		eit_event_struct *e = events[i].data;
+		time_t t = parseDVBtime(e->start_time_1, e->start_time_2, e->start_time_3, e->start_time_4, e->start_time_5);
+		if (t == 3599)
+			continue;
+		t += shift;
+		int mjd = t / 86400 + 40587;
+		int secs = t % 86400;
+		e->start_time_1 = mjd >> 8;
+		e->start_time_2 = mjd & 0xFF;
+		e->start_time_3 = toBCD(secs / 3600);
+		e->start_time_4 = toBCD(secs / 60 % 60);
+		e->start_time_5 = toBCD(secs % 60);
+	}
+}
+
+static void benchEventData(int passes)
+{
+	std::vector<eventData*> cached;
+	cached.reserve(events.size() * passes);
+
+	double start = now();
+	for (int pass = 0; pass < passes; ++pass)
+		for (size_t i = 0; i < events.size(); ++i)
+			cached.push_back(new eventData(events[i].data, events[i].size, 0));
+	double t = now() - start;
+	printf("ingest: %zu events in %.3fs, %.0f events/s\n", cached.size(), t, cached.size() / t);
+
+	start = now();
+	size_t bytes = 0;
+	for (size_t i = 0; i < cached.size(); ++i)
+		bytes += HILO(cached[i]->get()->descriptors_loop_length);
+	t = now() - start;
+	printf("get: %zu events (%zu descriptor bytes) in %.3fs, %.0f events/s\n", cached.size(), bytes, t, cached.size() / t);
+
+	start = now();
+	for (size_t i = 0; i < cached.size(); ++i)
+		delete cached[i];
+	t = now() - start;
+	printf("free: %zu events in %.3fs, %.0f events/s\n", cached.size(), t, cached.size() / t);
+}
+
+static eEPGDescriptorStore store;
+static volatile bool ingesting;
+
+static void *lookupThread(void *arg)
+{
+	size_t *lookups = (size_t*)arg;
+	size_t i = 0;
+	while (ingesting)
+	{
+		store.lookup(crcs[i]);
+		if (++i == crcs.size())
+			i = 0;
+		++*lookups;
+	}
+	return 0;
+}
+
+	/* lookups from a second thread (like lookupEventTime from the UI)
+	   while descriptors are interned and released by the ingest thread */
+static void benchContention(int passes)
+{
+	size_t lookups = 0;
+	ingesting = true;
+	pthread_t reader;
+	pthread_create(&reader, 0, lookupThread, &lookups);
+
+	double start = now();
+	for (int pass = 0; pass < passes; ++pass)
+	{
+		for (size_t i = 0; i < crcs.size(); ++i)
+			store.ref(crcs[i], crc_descr[i]);
+		for (size_t i = 0; i < crcs.size(); ++i)
+			store.unref(crcs[i]);
+	}
+	double t = now() - start;
+	ingesting = false;
+	pthread_join(reader, 0);
+	printf("contention: %zu ref/unref in %.3fs, %.0f descriptors/s, %.0f concurrent lookups/s\n",
+		2 * crcs.size() * passes, t, 2 * crcs.size() * passes / t, lookups / t);
+}
+
+	/* the events of a 50 row x 6 hour grid (like GraphMultiEPG), once with
+	   a lookup and parsed result per row like lookupEvent does (without
+	   the python objects), once packed with eEPGPackedResult */
+static void benchGrid(int passes)
+{
+	enum { ROWS = 50, MINUTES = 360 };
+	std::map<int, std::map<time_t, eventData*> > services;
+	for (size_t i = 0; i < events.size(); ++i)
+	{
+		eventData *ev = new eventData(events[i].data, events[i].size, 0);
+		eventData *&slot = services[events[i].sid][ev->getStartTime()];
+		delete slot;
+		slot = ev;
+	}
+
+	std::vector<timeMap*> rows;
+	for (std::map<int, std::map<time_t, eventData*> >::iterator it(services.begin()); it != services.end() && rows.size() < ROWS; ++it)
+	{
+		timeMap *tmMap = new timeMap;
+		for (std::map<time_t, eventData*>::iterator i(it->second.begin()); i != it->second.end(); ++i)
+			tmMap->push_back(timeMap::value_type(i->first, i->second));
+		rows.push_back(tmMap);
+	}
+	time_t begin = rows[0]->begin()->first, end = begin + MINUTES * 60;
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+	size_t cnt = 0;
+	double start = now();
+	for (int pass = 0; pass < passes; ++pass)
+	{
+		for (size_t r = 0; r < rows.size(); ++r)
+		{
+			singleLock s(lock);
+			std::vector<std::pair<time_t, std::string> > row;
+			for (timeMap::iterator it(rows[r]->lower_bound(begin)); it != rows[r]->end() && it->first < end; ++it)
+			{
+				Event ev((uint8_t*)it->second->get());
+				eServiceEvent evt;
+				evt.parseFrom(&ev, 0);
+				row.push_back(std::make_pair(evt.getBeginTime(), evt.getEventName()));
+				++cnt;
+			}
+		}
+	}
+	double t = now() - start;
+	printf("grid per row: %zu rows, %zu events in %.3fs, %.1f grids/s\n", rows.size(), cnt / passes, t, passes / t);
+
+	std::string packed;
+	start = now();
+	for (int pass = 0; pass < passes; ++pass)
+	{
+		eEPGPackedResult result(rows.size(), cnt / passes);
+		{
+			singleLock s(lock);
+			for (size_t r = 0; r < rows.size(); ++r)
+			{
+				result.addService();
+				for (timeMap::iterator it(rows[r]->lower_bound(begin)); it != rows[r]->end() && it->first < end; ++it)
+					result.addEvent(it->second, 0);
+			}
+		}
+		result.finish(packed);
+	}
+	t = now() - start;
+	printf("grid packed: %zu bytes in %.3fs, %.1f grids/s\n", packed.size(), t, passes / t);
+
+	for (size_t r = 0; r < rows.size(); ++r)
+		delete rows[r];
+	for (std::map<int, std::map<time_t, eventData*> >::iterator it(services.begin()); it != services.end(); ++it)
+		for (std::map<time_t, eventData*>::iterator i(it->second.begin()); i != it->second.end(); ++i)
+			delete i->second;
+}
+
+	/* the strings of the short and extended event descriptors through
+	   convertDVBUTF8, as latin-1 and with the two char mapping */
+static void benchText(int passes)
+{
+	std::vector<std::pair<const __u8*, int> > strings;
+	size_t bytes = 0;
+	for (size_t i = 0; i < crc_descr.size(); ++i)
+	{
+		const __u8 *descr = crc_descr[i];
+		const __u8 *end = descr + descr[1] + 2;
+		const __u8 *p;
+		if (descr[0] == 0x4D && descr[1] >= 5) // short event: name, text
+		{
+			p = descr + 5;
+			for (int n = 0; n < 2 && p < end && p + 1 + *p <= end; ++n, p += 1 + *p)
+				strings.push_back(std::make_pair(p + 1, (int)*p));
+		}
+		else if (descr[0] == 0x4E && descr[1] >= 6) // extended event: text after the items
+		{
+			p = descr + 7 + descr[6];
+			if (p < end && p + 1 + *p <= end)
+				strings.push_back(std::make_pair(p + 1, (int)*p));
+		}
+	}
+	for (size_t i = 0; i < strings.size(); ++i)
+		bytes += strings[i].second;
+
+	for (int table = 1; table >= 0; --table)
+	{
+		size_t out = 0;
+		double start = now();
+		for (int pass = 0; pass < passes; ++pass)
+			for (size_t i = 0; i < strings.size(); ++i)
+				out += convertDVBUTF8(strings[i].first, strings[i].second, table, 0).size();
+		double t = now() - start;
+		printf("convertDVBUTF8 %s: %zu strings, %zu bytes -> %zu bytes in %.3fs, %.1f MB/s\n",
+			table ? "latin-1" : "two char mapping", strings.size(), bytes, out / passes, t, bytes * passes / t / 1e6);
+	}
+}
+
+	/* the sections through eEPGCache::sectionRead, then lookupEventTime of
+	   random services and times like the infobar and epg lists do */
+static void benchCache(int passes)
+{
+	eEPGCache *cache = new eEPGCache();
+	double start = now();
+	for (int pass = 0; pass < passes; ++pass)
+		for (size_t i = 0; i < sections.size(); ++i)
+			cache->replaySection(sections[i]);
+	double t = now() - start;
+	printf("sectionRead: %zu sections, %zu events in %.3fs, %.0f events/s\n",
+		sections.size() * passes, events.size() * passes, t, events.size() * passes / t);
+
+	std::vector<eServiceReferenceDVB> refs;
+	for (size_t i = 0; i < sections.size(); ++i)
+	{
+		eit_t *eit = (eit_t*)sections[i];
+		eServiceReferenceDVB ref(eDVBNamespace(0), eTransportStreamID(HILO(eit->transport_stream_id)),
+			eOriginalNetworkID(HILO(eit->original_network_id)), eServiceID(HILO(eit->service_id)), 1);
+		if (std::find(refs.begin(), refs.end(), ref) == refs.end())
+			refs.push_back(ref);
+	}
+
+	enum { LOOKUPS = 100000 };
+	std::vector<double> latency;
+	latency.reserve(LOOKUPS);
+	time_t base = ::time(0);
+	int found = 0;
+	srand(1);
+	for (int i = 0; i < LOOKUPS; ++i)
+	{
+		const eventData *ev = 0;
+		const eServiceReferenceDVB &ref = refs[rand() % refs.size()];
+		time_t when = base + rand() % (24*60*60);
+		double s = now();
+		if (!cache->lookupEventTime(ref, when, ev))
+			++found;
+		latency.push_back(now() - s);
+	}
+	std::sort(latency.begin(), latency.end());
+	printf("lookupEventTime: %d lookups in %zu services (%d found), p50 %.2fus, p99 %.2fus\n",
+		LOOKUPS, refs.size(), found, latency[LOOKUPS / 2] * 1e6, latency[LOOKUPS * 99 / 100] * 1e6);
+
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	printf("CacheSize %d bytes, peak rss %ld kB\n", eventData::getCacheSize(), usage.ru_maxrss);
+	delete cache;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		printf("usage: %s <eit dump> [passes]\n", argv[0]);
+		return 1;
+	}
+	int passes = argc > 2 ? atoi(argv[2]) : 10;
+
+	std::vector<__u8> dump;
+	if (readDump(argv[1], dump))
+		return 1;
+	splitSections(dump);
+	if (events.empty())
+		return 1;
+	shiftTimes();
+
+	benchEventData(passes);
+	benchContention(passes);
+	benchGrid(passes);
+	benchText(passes);
+	benchCache(passes);
+	return 0;
+}
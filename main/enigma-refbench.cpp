@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <vector>
+#include <lib/base/object.h>
+
+/*
+ * Reference counting benchmark for DECLARE_REF/DEFINE_REF and ePtr.
+ * It measures AddRef/Release pairs, ePtr copies, moves (when built as
+ * c++11) and copies of one shared object from several threads, which is
+ * the case of the service and demux references passed between the
+ * mainloop and the worker threads.
+ *
+ * usage: enigma-refbench [iterations] [threads]
+ */
+
+class eRefBenchObject: public iObject
+{
+	DECLARE_REF(eRefBenchObject);
+public:
+	int value;
+	eRefBenchObject(): value(0) { }
+};
+DEFINE_REF(eRefBenchObject);
+
+static double now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *what, long iterations, double t)
+{
+	printf("%-28s %10ld in %6.3fs, %6.2fns each\n", what, iterations, t, t * 1e9 / iterations);
+}
+
+	/* not inlined, so the copies are not optimized away */
+static int __attribute__((noinline)) use(ePtr<eRefBenchObject> p)
+{
+	return p->value;
+}
+
+static ePtr<eRefBenchObject> __attribute__((noinline)) pass(ePtr<eRefBenchObject> &p)
+{
+	ePtr<eRefBenchObject> tmp = p;
+	return tmp;
+}
+
+static ePtr<eRefBenchObject> shared;
+static volatile int sink;
+static long thread_iterations;
+
+static void *copyThread(void *)
+{
+	int sum = 0;
+	for (long i = 0; i < thread_iterations; ++i)
+		sum += use(shared);
+	return (void*)(long)sum;
+}
+
+int main(int argc, char **argv)
+{
+	long iterations = argc > 1 ? atol(argv[1]) : 10000000;
+	int threads = argc > 2 ? atoi(argv[2]) : 4;
+	ePtr<eRefBenchObject> obj = new eRefBenchObject;
+	int sum = 0;
+	double t;
+
+	t = now();
+	for (long i = 0; i < iterations; ++i)
+	{
+		obj->AddRef();
+		obj->Release();
+	}
+	report("AddRef/Release", iterations, now() - t);
+
+	t = now();
+	for (long i = 0; i < iterations; ++i)
+		sum += use(obj);
+	report("ePtr copy", iterations, now() - t);
+
+	t = now();
+	for (long i = 0; i < iterations; ++i)
+	{
+		ePtr<eRefBenchObject> p = pass(obj);
+		sum += p->value;
+	}
+	report("ePtr return", iterations, now() - t);
+
+#if __cplusplus >= 201103L
+	t = now();
+	for (long i = 0; i < iterations; ++i)
+	{
+		ePtr<eRefBenchObject> p = obj;
+		ePtr<eRefBenchObject> q = std::move(p);
+		sum += use(std::move(q));
+	}
+	report("ePtr copy + 2 moves", iterations, now() - t);
+
+	t = now();
+	{
+		std::vector<ePtr<eRefBenchObject> > v;
+		for (long i = 0; i < iterations / 10; ++i)
+			v.push_back(obj); // the reallocations move the elements
+	}
+	report("vector<ePtr> push_back", iterations / 10, now() - t);
+#endif
+
+	shared = obj;
+	thread_iterations = iterations / threads;
+	std::vector<pthread_t> tid(threads);
+	t = now();
+	for (int i = 0; i < threads; ++i)
+		pthread_create(&tid[i], 0, copyThread, 0);
+	for (int i = 0; i < threads; ++i)
+		pthread_join(tid[i], 0);
+	char what[64];
+	snprintf(what, sizeof(what), "ePtr copy, %d threads", threads);
+	report(what, thread_iterations * threads, now() - t);
+	shared = 0;
+
+	sink = sum;
+	return 0;
+}
@@ -13,6 +13,7 @@
 #include <lib/base/eerror.h>
 #include <lib/base/init.h>
 #include <lib/base/init_num.h>
+#include <lib/base/loopprofile.h>
 #include <lib/gdi/gmaindc.h>
 #include <lib/gdi/glcddc.h>
 #include <lib/gdi/grc.h>
@@ -275,6 +276,7 @@ int main(int argc, char **argv)
 	bsodCatchSignals();
 
 	setSigTermHandler();
+	eMainloopProfile::installSignalHandler();
 
 	setIoPrio(IOPRIO_CLASS_BE, 3);
 